@@ -7,6 +7,32 @@
 #include <iomanip>
 #include <sstream>
 #include <array>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+#include <chrono>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <cstddef>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <unordered_set>
+#include <memory>
+#include <functional>
+#include <deque>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
@@ -17,7 +43,7 @@ const int WIDTH = 800, HEIGHT = 600;
 
 // World dimensions
 const int CHUNK_SIZE = 16;  // 8x8 chunks for better performance
-const int WORLD_HEIGHT = 8;
+const int WORLD_HEIGHT = 64;
 
 
 // Colors
@@ -47,16 +73,631 @@ int frameCount = 0;
 double fps = 0.0;
 
 
-// Block system
-enum BlockType { AIR, DIRT, COBBLESTONE, SAND, WOOD, GLASS };
+// Block system. Blocks are stored as one byte each; widen BlockStorage to
+// uint16_t if the block list ever outgrows it.
+typedef uint8_t BlockStorage;
+enum BlockType : BlockStorage { AIR, DIRT, COBBLESTONE, SAND, WOOD, GLASS, BLOCK_TYPE_COUNT };
+static_assert(sizeof(BlockType) == sizeof(BlockStorage), "BlockType must be stored in BlockStorage");
+static_assert(BLOCK_TYPE_COUNT - 1 <= std::numeric_limits<BlockStorage>::max(), "block ids no longer fit in BlockStorage");
 BlockType currentBlock = DIRT;
-std::vector<std::vector<std::vector<BlockType>>> blocks(
-   CHUNK_SIZE,
-   std::vector<std::vector<BlockType>>(
-       WORLD_HEIGHT,
-       std::vector<BlockType>(CHUNK_SIZE, AIR)
-   )
-);
+
+
+// Unpacked block order: y-major so each horizontal layer is a contiguous slab
+// and x is the fastest-moving coordinate in every scan
+const int CHUNK_VOLUME = CHUNK_SIZE * WORLD_HEIGHT * CHUNK_SIZE;
+
+
+inline int blockIndex(int x, int y, int z) {
+   return (y * CHUNK_SIZE + z) * CHUNK_SIZE + x;
+}
+
+
+// Chunks are split vertically into 16x16x16 sections. A section keeps a
+// palette of the block types it contains and a bit-packed array of palette
+// indices in blockIndex() order. Indices are 1, 2, 4 or 8 bits wide, growing
+// with the palette, so an entry never straddles a 64-bit word. A section made
+// of a single block type (open sky, solid rock) keeps just that one palette
+// entry and no index array at all.
+const int SECTION_SIZE = 16;
+const int SECTION_VOLUME = SECTION_SIZE * SECTION_SIZE * SECTION_SIZE;
+const int SECTIONS_PER_CHUNK = WORLD_HEIGHT / SECTION_SIZE;
+static_assert(CHUNK_SIZE == SECTION_SIZE && WORLD_HEIGHT % SECTION_SIZE == 0, "chunks must be a stack of whole sections");
+static_assert(BLOCK_TYPE_COUNT <= 256, "palette indices are at most 8 bits");
+
+
+struct ChunkSection {
+   std::vector<BlockType> palette;
+   std::vector<uint64_t> data;
+   int bitsLog2 = 0;
+
+
+   ChunkSection() : palette(1, AIR) {}
+
+
+   bool isUniform() const { return data.empty(); }
+
+
+   BlockType get(int index) const {
+       if (data.empty()) return palette[0];
+       int perWordLog2 = 6 - bitsLog2;
+       int shift = (index & ((1 << perWordLog2) - 1)) << bitsLog2;
+       uint64_t mask = (1ULL << (1 << bitsLog2)) - 1;
+       return palette[(data[index >> perWordLog2] >> shift) & mask];
+   }
+
+
+   void set(int index, BlockType type) {
+       if (data.empty()) {
+           if (type == palette[0]) return;
+           data.assign(SECTION_VOLUME / 64, 0);
+       }
+       uint64_t id = paletteIndex(type);
+       int perWordLog2 = 6 - bitsLog2;
+       int shift = (index & ((1 << perWordLog2) - 1)) << bitsLog2;
+       uint64_t mask = (1ULL << (1 << bitsLog2)) - 1;
+       uint64_t& word = data[index >> perWordLog2];
+       word = (word & ~(mask << shift)) | (id << shift);
+   }
+
+
+   int paletteIndex(BlockType type) {
+       for (size_t i = 0; i < palette.size(); i++) {
+           if (palette[i] == type) return i;
+       }
+       if (palette.size() == (1u << (1 << bitsLog2))) grow();
+       palette.push_back(type);
+       return palette.size() - 1;
+   }
+
+
+   // Doubles the index width and repacks every entry
+   void grow() {
+       std::vector<uint8_t> indices(SECTION_VOLUME);
+       int perWordLog2 = 6 - bitsLog2;
+       uint64_t mask = (1ULL << (1 << bitsLog2)) - 1;
+       for (int i = 0; i < SECTION_VOLUME; i++) {
+           int shift = (i & ((1 << perWordLog2) - 1)) << bitsLog2;
+           indices[i] = (data[i >> perWordLog2] >> shift) & mask;
+       }
+
+
+       bitsLog2++;
+       perWordLog2 = 6 - bitsLog2;
+       data.assign(SECTION_VOLUME >> perWordLog2, 0);
+       for (int i = 0; i < SECTION_VOLUME; i++) {
+           int shift = (i & ((1 << perWordLog2) - 1)) << bitsLog2;
+           data[i >> perWordLog2] |= (uint64_t)indices[i] << shift;
+       }
+   }
+
+
+   // Drops the index array if every entry refers to the same palette entry
+   void collapseIfUniform() {
+       if (data.empty()) return;
+       uint64_t mask = (1ULL << (1 << bitsLog2)) - 1;
+       uint64_t id = data[0] & mask;
+       uint64_t pattern = id * (~0ULL / mask);
+       for (uint64_t word : data) {
+           if (word != pattern) return;
+       }
+       palette = std::vector<BlockType>(1, palette[id]);
+       std::vector<uint64_t>().swap(data);
+       bitsLog2 = 0;
+   }
+
+
+   // Decodes the whole section into out[0..SECTION_VOLUME), a word at a time
+   void unpack(BlockType* out) const {
+       if (data.empty()) {
+           std::fill(out, out + SECTION_VOLUME, palette[0]);
+           return;
+       }
+       int bits = 1 << bitsLog2;
+       int perWord = 64 >> bitsLog2;
+       uint64_t mask = (1ULL << bits) - 1;
+       for (size_t w = 0; w < data.size(); w++) {
+           uint64_t word = data[w];
+           for (int i = 0; i < perWord; i++) {
+               *out++ = palette[word & mask];
+               word >>= bits;
+           }
+       }
+   }
+
+
+   size_t memoryBytes() const {
+       return sizeof(ChunkSection) + palette.capacity() * sizeof(BlockType) + data.capacity() * sizeof(uint64_t);
+   }
+};
+
+
+static_assert(WORLD_HEIGHT <= 64, "solid layers must fit in a 64-bit mask");
+
+
+// Section visibility: bit a * 6 + b is set when faces a and b of a section are
+// joined by a path through air or glass
+const uint64_t ALL_FACES_CONNECTED = (1ULL << 36) - 1;
+
+
+// Chunk mesh, kept resident on the GPU and rebuilt only when blocks change.
+// Vertices are chunk-local and live in pages of the shared vertex arena.
+// In instanced mode the chunk has its own VBO holding one ChunkVertex per
+// visible cube instead, the counts are instances, the chunk's offset goes in
+// the model matrix, and transparentVAO starts its instance stream at the
+// first glass cube.
+struct ChunkMesh {
+   unsigned int VAO = 0, VBO = 0;
+   unsigned int transparentVAO = 0;
+   int firstPage = -1, pageCount = 0;
+   int opaqueVertexCount = 0;
+   int transparentVertexCount = 0;
+   int emittedFaces = 0;
+   int totalFaces = 0;
+   int minY = 0, maxY = 0;       // layers holding any block, maxY exclusive
+   uint64_t solidLayers = 0;     // bit y set when layer y is entirely opaque
+   uint64_t sectionVisibility[SECTIONS_PER_CHUNK] = { ALL_FACES_CONNECTED, ALL_FACES_CONNECTED, ALL_FACES_CONNECTED, ALL_FACES_CONNECTED };
+   bool dirty = true;
+   uint64_t pendingJob = 0;  // meshing job whose result this mesh is waiting for, 0 if none
+};
+
+
+// A chunk's blocks. Never modified once published: writers edit a copy and
+// swap it in, so readers on other threads hold a consistent version for as
+// long as they keep a reference, without locking.
+struct ChunkData {
+   ChunkSection sections[SECTIONS_PER_CHUNK];
+
+
+   BlockType get(int x, int y, int z) const {
+       return sections[y / SECTION_SIZE].get(blockIndex(x, y % SECTION_SIZE, z));
+   }
+   void set(int x, int y, int z, BlockType type) {
+       sections[y / SECTION_SIZE].set(blockIndex(x, y % SECTION_SIZE, z), type);
+   }
+
+
+   bool isEmpty() const {
+       for (const ChunkSection& section : sections) {
+           if (!section.isUniform() || section.palette[0] != AIR) return false;
+       }
+       return true;
+   }
+
+
+   void collapseUniformSections() {
+       for (ChunkSection& section : sections) section.collapseIfUniform();
+   }
+
+
+   int uniformSectionCount() const {
+       int count = 0;
+       for (const ChunkSection& section : sections) count += section.isUniform();
+       return count;
+   }
+
+
+   size_t averageSectionBytes() const {
+       size_t total = 0;
+       for (const ChunkSection& section : sections) total += section.memoryBytes();
+       return total / SECTIONS_PER_CHUNK;
+   }
+
+
+   // Decodes the whole chunk into out[0..CHUNK_VOLUME) in blockIndex() order
+   void unpack(BlockType* out) const {
+       for (int s = 0; s < SECTIONS_PER_CHUNK; s++) {
+           sections[s].unpack(out + s * SECTION_VOLUME);
+       }
+   }
+};
+
+
+// The main thread owns `data`: it alone edits chunks, publishes new versions
+// and takes snapshot()s, which it hands to jobs and the I/O thread. Those
+// threads only read the blocks and drop their reference, so reading never
+// takes a lock. A chunk being loaded belongs to the I/O thread until it is
+// handed over.
+struct Chunk {
+   int cx = 0, cz = 0;
+   std::shared_ptr<const ChunkData> data = std::make_shared<ChunkData>();
+   ChunkMesh mesh;
+   bool modified = false;  // edited since it was generated or loaded, needs saving
+
+
+   BlockType get(int x, int y, int z) const { return data->get(x, y, z); }
+
+
+   // Copies the blocks for a single edit; batches of edits should go
+   // through copyData() and publish() instead
+   void set(int x, int y, int z, BlockType type) {
+       if (data->get(x, y, z) == type) return;
+       std::shared_ptr<ChunkData> next = copyData();
+       next->set(x, y, z, type);
+       next->sections[y / SECTION_SIZE].collapseIfUniform();
+       publish(next);
+   }
+
+
+   std::shared_ptr<const ChunkData> snapshot() const { return data; }
+   std::shared_ptr<ChunkData> copyData() const { return std::make_shared<ChunkData>(*data); }
+   void publish(std::shared_ptr<const ChunkData> next) { data = std::move(next); }
+};
+
+
+// World: an unbounded grid of chunks addressed by chunk coordinates. World
+// block coordinates split into chunk + local with a shift and a mask, which
+// also floors negative coordinates correctly.
+const int CHUNK_SHIFT = 4;
+static_assert(1 << CHUNK_SHIFT == CHUNK_SIZE, "CHUNK_SHIFT must match CHUNK_SIZE");
+
+
+inline uint64_t chunkKey(int cx, int cz) {
+   return ((uint64_t)(uint32_t)cx << 32) | (uint32_t)cz;
+}
+
+
+// Open-addressing hash map from chunkKey() to chunks. Linear probing with
+// backward-shift deletion, so there are no tombstones and a lookup stops at
+// the first empty slot.
+struct ChunkMap {
+   struct Slot {
+       uint64_t key;
+       Chunk* chunk;
+   };
+   std::vector<Slot> slots;
+   size_t count = 0;
+
+
+   ChunkMap() : slots(64, Slot{0, nullptr}) {}
+
+
+   static size_t hash(uint64_t key) {
+       key ^= key >> 33;
+       key *= 0xff51afd7ed558ccdULL;
+       key ^= key >> 33;
+       key *= 0xc4ceb9fe1a85ec53ULL;
+       key ^= key >> 33;
+       return key;
+   }
+
+
+   Chunk* find(int cx, int cz) const {
+       uint64_t key = chunkKey(cx, cz);
+       size_t mask = slots.size() - 1;
+       for (size_t i = hash(key) & mask; slots[i].chunk; i = (i + 1) & mask) {
+           if (slots[i].key == key) return slots[i].chunk;
+       }
+       return nullptr;
+   }
+
+
+   void insert(int cx, int cz, Chunk* chunk) {
+       if ((count + 1) * 4 > slots.size() * 3) rehash(slots.size() * 2);
+       uint64_t key = chunkKey(cx, cz);
+       size_t mask = slots.size() - 1;
+       size_t i = hash(key) & mask;
+       while (slots[i].chunk && slots[i].key != key) i = (i + 1) & mask;
+       if (!slots[i].chunk) count++;
+       slots[i] = Slot{key, chunk};
+   }
+
+
+   // Removes and returns the chunk, or nullptr if it was not present
+   Chunk* remove(int cx, int cz) {
+       uint64_t key = chunkKey(cx, cz);
+       size_t mask = slots.size() - 1;
+       size_t i = hash(key) & mask;
+       while (slots[i].chunk && slots[i].key != key) i = (i + 1) & mask;
+       Chunk* removed = slots[i].chunk;
+       if (!removed) return nullptr;
+
+
+       // Pull later entries of the probe run back into the hole
+       size_t hole = i;
+       for (size_t j = (i + 1) & mask; slots[j].chunk; j = (j + 1) & mask) {
+           size_t home = hash(slots[j].key) & mask;
+           if (((j - home) & mask) >= ((j - hole) & mask)) {
+               slots[hole] = slots[j];
+               hole = j;
+           }
+       }
+       slots[hole] = Slot{0, nullptr};
+       count--;
+       return removed;
+   }
+
+
+   void rehash(size_t capacity) {
+       std::vector<Slot> old(capacity, Slot{0, nullptr});
+       old.swap(slots);
+       size_t mask = slots.size() - 1;
+       for (const Slot& slot : old) {
+           if (!slot.chunk) continue;
+           size_t i = hash(slot.key) & mask;
+           while (slots[i].chunk) i = (i + 1) & mask;
+           slots[i] = slot;
+       }
+   }
+};
+ChunkMap world;
+
+
+// Chunk streaming: chunks within renderDistance of the camera are kept
+// resident, loading nearest-first with a bias towards where the camera looks,
+// and loading stops for the frame once the time budget is spent
+int renderDistance = 8;
+const double STREAMING_BUDGET_MS = 4.0;
+std::vector<glm::ivec2> pendingChunks;
+int meshJobsInFlight = 0;
+size_t meshUploadsWaiting = 0;
+
+
+// Chunk I/O thread. All region file access happens on it: the main thread
+// queues encoded snapshots of modified chunks and read requests, and collects
+// finished reads. A snapshot queued while an older one for the same chunk is
+// still waiting replaces it. Region files are only fsynced at checkpoints.
+const double AUTOSAVE_INTERVAL = 5.0;
+const double CHECKPOINT_INTERVAL = 30.0;
+
+
+struct ChunkWrite {
+   int cx, cz;
+   std::shared_ptr<const ChunkData> data;  // encoded on the I/O thread
+};
+
+
+struct ChunkRead {
+   int cx, cz;
+   Chunk* chunk;  // nullptr when the chunk was never saved
+};
+
+
+struct ChunkIO {
+   std::thread thread;
+   std::mutex mutex;
+   std::condition_variable wake;
+   std::unordered_map<uint64_t, ChunkWrite> pendingWrites;
+   std::vector<glm::ivec2> pendingReads;
+   std::vector<ChunkRead> completedReads;
+   bool checkpointRequested = false;
+   bool stopping = false;
+
+
+   std::atomic<uint64_t> chunksWritten{0};
+   std::atomic<uint64_t> bytesWritten{0};
+   std::atomic<uint64_t> writesCoalesced{0};
+   std::atomic<size_t> writesInFlight{0};
+};
+ChunkIO chunkIO;
+
+
+size_t chunkIOQueueDepth() {
+   std::lock_guard<std::mutex> lock(chunkIO.mutex);
+   return chunkIO.pendingWrites.size() + chunkIO.writesInFlight + chunkIO.pendingReads.size();
+}
+
+
+// Job system: a pool of workers for background engine work. Each worker has
+// a deque per priority; it takes its own newest job first and, when out of
+// work, steals the oldest job of another worker. High priority jobs anywhere
+// run before low priority ones. Threads waiting on jobs help run them.
+enum JobPriority { JOB_HIGH, JOB_LOW, JOB_PRIORITY_COUNT };
+
+
+struct JobWorker {
+   std::mutex mutex;
+   std::deque<std::function<void()>> queues[JOB_PRIORITY_COUNT];
+   std::thread thread;
+
+
+   std::atomic<uint64_t> busyMicros{0};
+   std::atomic<uint64_t> jobsRun{0};
+   std::atomic<uint64_t> jobsStolen{0};
+};
+
+
+struct JobSystem {
+   std::vector<JobWorker*> workers;
+   std::mutex sleepMutex;
+   std::condition_variable wake;
+   std::atomic<int> queued{0};
+   std::atomic<unsigned int> nextWorker{0};
+   bool stopping = false;
+};
+JobSystem jobSystem;
+thread_local int currentWorker = -1;  // index into jobSystem.workers, -1 off the pool
+
+
+void submitJob(std::function<void()> job, JobPriority priority = JOB_HIGH) {
+   // Workers keep what they spawn; other threads spread jobs round robin
+   int index = currentWorker >= 0 ? currentWorker : jobSystem.nextWorker++ % jobSystem.workers.size();
+   JobWorker* worker = jobSystem.workers[index];
+   {
+       std::lock_guard<std::mutex> lock(worker->mutex);
+       worker->queues[priority].push_back(std::move(job));
+   }
+   jobSystem.queued++;
+   std::lock_guard<std::mutex> lock(jobSystem.sleepMutex);
+   jobSystem.wake.notify_one();
+}
+
+
+// Runs one job if any is queued, returning false when there was none
+bool runOneJob() {
+   int self = currentWorker;
+   int count = jobSystem.workers.size();
+   std::function<void()> job;
+   bool stolen = false;
+
+
+   for (int priority = 0; priority < JOB_PRIORITY_COUNT && !job; priority++) {
+       if (self >= 0) {
+           JobWorker* worker = jobSystem.workers[self];
+           std::lock_guard<std::mutex> lock(worker->mutex);
+           if (!worker->queues[priority].empty()) {
+               job = std::move(worker->queues[priority].back());
+               worker->queues[priority].pop_back();
+           }
+       }
+       for (int i = 1; i <= count && !job; i++) {
+           int victim = (self + i) % count;
+           if (victim == self) continue;
+           JobWorker* worker = jobSystem.workers[victim];
+           std::lock_guard<std::mutex> lock(worker->mutex);
+           if (!worker->queues[priority].empty()) {
+               job = std::move(worker->queues[priority].front());
+               worker->queues[priority].pop_front();
+               stolen = true;
+           }
+       }
+   }
+   if (!job) return false;
+   jobSystem.queued--;
+
+
+   auto begin = std::chrono::steady_clock::now();
+   job();
+   if (self >= 0) {
+       JobWorker* worker = jobSystem.workers[self];
+       worker->busyMicros += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+       worker->jobsRun++;
+       worker->jobsStolen += stolen;
+   }
+   return true;
+}
+
+
+void jobWorkerThread(int index) {
+   currentWorker = index;
+   for (;;) {
+       if (runOneJob()) continue;
+       std::unique_lock<std::mutex> lock(jobSystem.sleepMutex);
+       jobSystem.wake.wait(lock, [] { return jobSystem.stopping || jobSystem.queued > 0; });
+       if (jobSystem.stopping && jobSystem.queued == 0) return;
+   }
+}
+
+
+void startJobs(int workerCount) {
+   jobSystem.stopping = false;
+   for (int i = 0; i < workerCount; i++) jobSystem.workers.push_back(new JobWorker());
+   for (int i = 0; i < workerCount; i++) jobSystem.workers[i]->thread = std::thread(jobWorkerThread, i);
+}
+
+
+// Lets the workers finish everything queued, then joins them
+void stopJobs() {
+   {
+       std::lock_guard<std::mutex> lock(jobSystem.sleepMutex);
+       jobSystem.stopping = true;
+   }
+   jobSystem.wake.notify_all();
+   for (JobWorker* worker : jobSystem.workers) {
+       worker->thread.join();
+       delete worker;
+   }
+   jobSystem.workers.clear();
+}
+
+
+// Runs jobs until `remaining` drops to zero
+void waitForJobs(const std::atomic<int>& remaining) {
+   while (remaining > 0) {
+       if (!runOneJob()) std::this_thread::yield();
+   }
+}
+
+
+// Splits [0, count) into ranges of at most `grain` items, runs body(begin, end)
+// on each as a job and returns once all of them are done
+void parallelFor(int count, int grain, const std::function<void(int, int)>& body, JobPriority priority = JOB_HIGH) {
+   std::atomic<int> remaining{(count + grain - 1) / grain};
+   for (int begin = 0; begin < count; begin += grain) {
+       int end = std::min(begin + grain, count);
+       submitJob([&body, &remaining, begin, end] {
+           body(begin, end);
+           remaining--;
+       }, priority);
+   }
+   waitForJobs(remaining);
+}
+
+
+BlockType getWorldBlock(int x, int y, int z) {
+   if (y < 0 || y >= WORLD_HEIGHT) return AIR;
+   Chunk* chunk = world.find(x >> CHUNK_SHIFT, z >> CHUNK_SHIFT);
+   if (!chunk) return AIR;
+   return chunk->get(x & (CHUNK_SIZE - 1), y, z & (CHUNK_SIZE - 1));
+}
+
+
+// A face is hidden when its neighbour is opaque, or when glass meets glass.
+bool isFaceVisible(BlockType type, BlockType neighbor) {
+   if (neighbor == AIR) return true;
+   if (neighbor == GLASS) return type != GLASS;
+   return false;
+}
+
+
+// Remeshing counters for the stats line
+int remeshesLastFrame = 0;
+long long remeshTotal = 0;
+long long blockEditTotal = 0;
+
+
+// Marks the chunk holding (x, y, z) for remeshing after its block changed
+// from `before` to `after`. A neighbouring chunk is only marked when the
+// block is on the shared border and the face the neighbour's block shows
+// against it appears or disappears. Marks just set a flag, so any number of
+// edits to a chunk within a frame cost a single remesh.
+void markBlockDirty(int x, int y, int z, BlockType before, BlockType after) {
+   Chunk* chunk = world.find(x >> CHUNK_SHIFT, z >> CHUNK_SHIFT);
+   if (chunk) chunk->mesh.dirty = true;
+
+
+   const int offsets[4][2] = { {-1, 0}, {1, 0}, {0, -1}, {0, 1} };
+   for (const auto& offset : offsets) {
+       int nx = x + offset[0], nz = z + offset[1];
+       Chunk* neighbor = world.find(nx >> CHUNK_SHIFT, nz >> CHUNK_SHIFT);
+       if (!neighbor || neighbor == chunk) continue;
+       BlockType facing = neighbor->get(nx & (CHUNK_SIZE - 1), y, nz & (CHUNK_SIZE - 1));
+       if (facing != AIR && isFaceVisible(facing, before) != isFaceVisible(facing, after)) {
+           neighbor->mesh.dirty = true;
+       }
+   }
+}
+
+
+// Returns false when the position is outside the world or its chunk is not loaded
+bool setWorldBlock(int x, int y, int z, BlockType type) {
+   if (y < 0 || y >= WORLD_HEIGHT) return false;
+   Chunk* chunk = world.find(x >> CHUNK_SHIFT, z >> CHUNK_SHIFT);
+   if (!chunk) return false;
+   BlockType before = chunk->get(x & (CHUNK_SIZE - 1), y, z & (CHUNK_SIZE - 1));
+   if (before == type) return true;
+   chunk->set(x & (CHUNK_SIZE - 1), y, z & (CHUNK_SIZE - 1), type);
+   chunk->modified = true;
+   blockEditTotal++;
+   markBlockDirty(x, y, z, before, type);
+   return true;
+}
+
+
+// Chunk vertices pack the chunk-local corner position x (5 bits), y (7) and
+// z (5), the face (3) and the block type (8) into 32 bits. The vertex shader
+// derives texture coordinates from the position and looks up the atlas
+// rectangle by type and face. Faces are indexed quads of 4 vertices.
+// Instanced cubes use the same layout: the instance supplies the block
+// position and type, which the shader adds to the unit cube's corners.
+typedef uint32_t ChunkVertex;
+const int VERTICES_PER_FACE = 4;
+const int INDICES_PER_FACE = 6;
+static_assert(CHUNK_SIZE < 32 && WORLD_HEIGHT < 128, "chunk vertex position fields too narrow");
+
+
+// Meshing strategy, chosen at startup with --mesher
+enum MesherMode { MESHER_CULLED, MESHER_GREEDY, MESHER_BINARY, MESHER_INSTANCED };
+MesherMode mesherMode = MESHER_CULLED;
 
 
 // Texture
@@ -72,6 +713,137 @@ unsigned int crosshairShader;
 bool wireframeMode = false;
 
 
+// Shadow of the GL state we touch every frame, so redundant binds and toggles never reach the driver
+struct GLState {
+   unsigned int program = 0;
+   unsigned int vertexArray = 0;
+   unsigned int texture = 0;
+   bool blend = false;
+   bool depthTest = false;
+   bool wireframe = false;
+   int calls = 0;
+   int callsLastFrame = 0;
+   int draws = 0;             // chunk draw calls, a multi-draw counting once
+   int drawsLastFrame = 0;
+   int drawnMeshes = 0;       // chunk meshes those draws covered
+   int drawnMeshesLastFrame = 0;
+};
+GLState glState;
+
+
+// Issues a GL call and counts it toward the per-frame stat. Everything the
+// frame loop sends to the driver goes through here, so the count is exact.
+template <typename Function, typename... Args>
+void callGL(Function function, Args... args) {
+   glState.calls++;
+   function(args...);
+}
+
+
+void useProgram(unsigned int program) {
+   if (glState.program == program) return;
+   callGL(glUseProgram, program);
+   glState.program = program;
+}
+
+
+void bindVertexArray(unsigned int vertexArray) {
+   if (glState.vertexArray == vertexArray) return;
+   callGL(glBindVertexArray, vertexArray);
+   glState.vertexArray = vertexArray;
+}
+
+
+void bindTexture(unsigned int texture) {
+   if (glState.texture == texture) return;
+   callGL(glBindTexture, GL_TEXTURE_2D, texture);
+   glState.texture = texture;
+}
+
+
+void setBlend(bool enabled) {
+   if (glState.blend == enabled) return;
+   if (enabled) callGL(glEnable, GL_BLEND);
+   else callGL(glDisable, GL_BLEND);
+   glState.blend = enabled;
+}
+
+
+void setDepthTest(bool enabled) {
+   if (glState.depthTest == enabled) return;
+   if (enabled) callGL(glEnable, GL_DEPTH_TEST);
+   else callGL(glDisable, GL_DEPTH_TEST);
+   glState.depthTest = enabled;
+}
+
+
+void setWireframe(bool enabled) {
+   if (glState.wireframe == enabled) return;
+   callGL(glPolygonMode, GL_FRONT_AND_BACK, enabled ? GL_LINE : GL_FILL);
+   glState.wireframe = enabled;
+}
+
+
+// Uniform locations of the chunk shader, looked up once after linking
+struct ChunkShader {
+   unsigned int program = 0;
+   int model = -1;
+   int view = -1;
+   int projection = -1;
+   int texture = -1;
+   int tileRects = -1;
+   int pagedOrigins = -1;
+   int chunkOrigins = -1;
+
+
+   void resolve(unsigned int linked) {
+       program = linked;
+       model = glGetUniformLocation(program, "model");
+       view = glGetUniformLocation(program, "view");
+       projection = glGetUniformLocation(program, "projection");
+       texture = glGetUniformLocation(program, "ourTexture");
+       tileRects = glGetUniformLocation(program, "tileRects");
+       pagedOrigins = glGetUniformLocation(program, "pagedOrigins");
+       chunkOrigins = glGetUniformLocation(program, "chunkOrigins");
+   }
+};
+
+
+void endGLFrame() {
+   glState.callsLastFrame = glState.calls;
+   glState.drawsLastFrame = glState.draws;
+   glState.drawnMeshesLastFrame = glState.drawnMeshes;
+   glState.calls = glState.draws = glState.drawnMeshes = 0;
+}
+
+
+// Chunks inside the view frustum this frame, in the order they are drawn
+std::vector<const Chunk*> visibleChunks;
+int chunksCulledLastFrame = 0;
+int chunksSealedLastFrame = 0;
+
+
+// Set at startup: one glMultiDrawElementsIndirect per pass when the context
+// supports it, one glMultiDrawElementsBaseVertex otherwise
+bool multiDrawIndirect = false;
+
+
+// Occlusion culling, toggled with O
+bool occlusionCulling = true;
+int chunksOccludedLastFrame = 0;
+double occlusionMillisLastFrame = 0.0;
+
+
+const char* getMesherName(MesherMode mode) {
+   switch(mode) {
+       case MESHER_GREEDY: return "Greedy";
+       case MESHER_BINARY: return "Binary";
+       case MESHER_INSTANCED: return "Instanced";
+       default: return "Culled";
+   }
+}
+
+
 const char* getBlockName(BlockType type) {
    switch(type) {
        case DIRT: return "Dirt";
@@ -176,13 +948,9 @@ RaycastResult rayCast(glm::vec3 start, glm::vec3 direction, float maxDist) {
 
 
        traveled = maxSide;
-      
-       if (mapPos.x < 0 || mapPos.x >= CHUNK_SIZE ||
-           mapPos.y < 0 || mapPos.y >= WORLD_HEIGHT ||
-           mapPos.z < 0 || mapPos.z >= CHUNK_SIZE) break;
 
 
-       if (blocks[mapPos.x][mapPos.y][mapPos.z] != AIR) {
+       if (getWorldBlock(mapPos.x, mapPos.y, mapPos.z) != AIR) {
            result.hit = true;
            result.blockPos = mapPos;
           
@@ -203,14 +971,10 @@ void handleBlockInteraction(GLFWwindow* window, int button, int action) {
        RaycastResult rc = rayCast(cameraPos, cameraFront, 8.0f);
        if (rc.hit) {
            if (button == GLFW_MOUSE_BUTTON_LEFT) {
-               blocks[rc.blockPos.x][rc.blockPos.y][rc.blockPos.z] = AIR;
+               setWorldBlock(rc.blockPos.x, rc.blockPos.y, rc.blockPos.z, AIR);
            } else if (button == GLFW_MOUSE_BUTTON_RIGHT) {
                glm::ivec3 newPos = rc.blockPos + rc.normal;
-               if (newPos.x >= 0 && newPos.x < CHUNK_SIZE &&
-                   newPos.y >= 0 && newPos.y < WORLD_HEIGHT &&
-                   newPos.z >= 0 && newPos.z < CHUNK_SIZE) {
-                   blocks[newPos.x][newPos.y][newPos.z] = currentBlock;
-               }
+               setWorldBlock(newPos.x, newPos.y, newPos.z, currentBlock);
            }
        }
    }
@@ -231,8 +995,11 @@ void toggleCursor(GLFWwindow* window) {
 void printStats() {
    double currentTime = glfwGetTime();
    frameCount++;
+   static int remeshPeak = 0;
+   remeshPeak = std::max(remeshPeak, remeshesLastFrame);
   
    if (currentTime - lastTime >= 0.25) {
+       int frames = frameCount;
        fps = frameCount / (currentTime - lastTime);
        frameCount = 0;
        lastTime = currentTime;
@@ -252,6 +1019,69 @@ void printStats() {
        std::cout << "\r\033[K";
        std::cout << "\033[37mFPS: " << fpsColor << static_cast<int>(fps) << "\033[0m";
        std::cout << " | \033[94m" << coordStream.str() << "\033[0m";
+       long long emittedFaces = 0, totalFaces = 0, vertexCount = 0, sectionBytes = 0, uniformSections = 0;
+       for (const ChunkMap::Slot& slot : world.slots) {
+           if (!slot.chunk) continue;
+           const ChunkMesh& mesh = slot.chunk->mesh;
+           emittedFaces += mesh.emittedFaces;
+           totalFaces += mesh.totalFaces;
+           vertexCount += mesh.opaqueVertexCount + mesh.transparentVertexCount;
+           sectionBytes += slot.chunk->data->averageSectionBytes();
+           uniformSections += slot.chunk->data->uniformSectionCount();
+       }
+       if (world.count > 0) sectionBytes /= world.count;
+
+
+       std::cout << " | \033[93mChunks: " << world.count << " (" << pendingChunks.size() << " pending, "
+                 << meshJobsInFlight << " meshing, " << meshUploadsWaiting << " to upload), "
+                 << visibleChunks.size() << " visible, " << chunksCulledLastFrame << " culled, "
+                 << chunksSealedLastFrame << " sealed, "
+                 << getMesherName(mesherMode) << " faces: " << emittedFaces << "/" << totalFaces;
+       std::cout << ", verts: " << vertexCount << "\033[0m";
+
+
+       static long long lastRemeshTotal = 0, lastBlockEditTotal = 0;
+       std::cout << " | \033[36mRemesh: " << std::fixed << std::setprecision(1)
+                 << (double)(remeshTotal - lastRemeshTotal) / frames << "/frame, peak " << remeshPeak
+                 << ", " << blockEditTotal - lastBlockEditTotal << " edits\033[0m";
+       lastRemeshTotal = remeshTotal;
+       lastBlockEditTotal = blockEditTotal;
+       remeshPeak = 0;
+       std::cout << " | \033[92mSection: " << sectionBytes << "/" << SECTION_VOLUME * sizeof(BlockType) << " B, uniform: "
+                 << uniformSections << "/" << world.count * SECTIONS_PER_CHUNK << "\033[0m";
+       static uint64_t lastChunksWritten = 0, lastBytesWritten = 0;
+       static double lastIOTime = currentTime;
+       uint64_t chunksWritten = chunkIO.chunksWritten, bytesWritten = chunkIO.bytesWritten;
+       double ioSeconds = std::max(currentTime - lastIOTime, 1e-6);
+       std::cout << " | \033[91mIO queue: " << chunkIOQueueDepth()
+                 << ", " << (chunksWritten - lastChunksWritten) / ioSeconds << " chunks/s, "
+                 << (bytesWritten - lastBytesWritten) / ioSeconds / (1024.0 * 1024.0) << " MB/s, "
+                 << chunkIO.writesCoalesced << " coalesced\033[0m";
+       lastChunksWritten = chunksWritten;
+       lastBytesWritten = bytesWritten;
+       lastIOTime = currentTime;
+
+
+       // Share of the time since the last update each worker spent running jobs
+       static std::vector<uint64_t> lastBusyMicros;
+       lastBusyMicros.resize(jobSystem.workers.size());
+       std::cout << " | \033[90mJobs:";
+       for (size_t i = 0; i < jobSystem.workers.size(); i++) {
+           uint64_t busy = jobSystem.workers[i]->busyMicros;
+           std::cout << (i ? "/" : " ") << std::min(100, (int)((busy - lastBusyMicros[i]) / (ioSeconds * 1e4)));
+           lastBusyMicros[i] = busy;
+       }
+       std::cout << "%\033[0m";
+       std::cout << " | \033[33mOcclusion: ";
+       if (occlusionCulling) {
+           std::cout << chunksOccludedLastFrame << " rejected, " << std::fixed << std::setprecision(2)
+                     << occlusionMillisLastFrame << " ms\033[0m";
+       } else {
+           std::cout << "OFF\033[0m";
+       }
+       const char* submission = mesherMode == MESHER_INSTANCED ? "per chunk" : multiDrawIndirect ? "indirect" : "multi-draw";
+       std::cout << " | \033[90mGL: " << glState.callsLastFrame << " calls, " << glState.drawsLastFrame
+                 << " draws for " << glState.drawnMeshesLastFrame << " meshes/frame (" << submission << ")\033[0m";
        std::cout << " | \033[95mWireframe: " << (wireframeMode ? "ON" : "OFF") << "\033[0m";
        std::cout << " | \033[96mBlock: " << getBlockName(currentBlock) << "\033[0m" << std::flush;
    }
@@ -283,6 +1113,17 @@ void processInput(GLFWwindow* window) {
    }
 
 
+   static bool occlusionKeyPressed = false;
+   if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS) {
+       if (!occlusionKeyPressed) {
+           occlusionCulling = !occlusionCulling;
+           occlusionKeyPressed = true;
+       }
+   } else {
+       occlusionKeyPressed = false;
+   }
+
+
    if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS) currentBlock = DIRT;
    if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS) currentBlock = COBBLESTONE;
    if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS) currentBlock = SAND;
@@ -354,7 +1195,7 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
 
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
-   glViewport(0, 0, width, height);
+   callGL(glViewport, 0, 0, width, height);
 }
 
 
@@ -382,201 +1223,2585 @@ unsigned int loadTexture(const char* path) {
 }
 
 
-void drawCube(float x, float y, float z, BlockType type) {
-   FaceUVs front = getFaceUVs(type, "front");
-   FaceUVs back = getFaceUVs(type, "back");
-   FaceUVs left = getFaceUVs(type, "left");
-   FaceUVs right = getFaceUVs(type, "right");
-   FaceUVs top = getFaceUVs(type, "top");
-   FaceUVs bottom = getFaceUVs(type, "bottom");
-
-
-   float x0 = x;
-   float x1 = x + 1.0f;
-   float y0 = y;
-   float y1 = y + 1.0f;
-   float z0 = z;
-   float z1 = z + 1.0f;
-
-
-   float vertices[] = {
-       // Back face
-       x0, y0, z0,   back.u0, back.v0,
-       x1, y0, z0,   back.u1, back.v0,
-       x1, y1, z0,   back.u1, back.v1,
-       x1, y1, z0,   back.u1, back.v1,
-       x0, y1, z0,   back.u0, back.v1,
-       x0, y0, z0,   back.u0, back.v0,
-
-
-       // Front face
-       x0, y0, z1,   front.u0, front.v0,
-       x1, y0, z1,   front.u1, front.v0,
-       x1, y1, z1,   front.u1, front.v1,
-       x1, y1, z1,   front.u1, front.v1,
-       x0, y1, z1,   front.u0, front.v1,
-       x0, y0, z1,   front.u0, front.v0,
-
-
-       // Left face
-       x0, y1, z1,   left.u0, left.v1,
-       x0, y1, z0,   left.u1, left.v1,
-       x0, y0, z0,   left.u1, left.v0,
-       x0, y0, z0,   left.u1, left.v0,
-       x0, y0, z1,   left.u0, left.v0,
-       x0, y1, z1,   left.u0, left.v1,
-
-
-       // Right face
-       x1, y1, z1,   right.u1, right.v1,
-       x1, y1, z0,   right.u0, right.v1,
-       x1, y0, z0,   right.u0, right.v0,
-       x1, y0, z0,   right.u0, right.v0,
-       x1, y0, z1,   right.u1, right.v0,
-       x1, y1, z1,   right.u1, right.v1,
-
-
-       // Bottom face
-       x0, y0, z0,   bottom.u0, bottom.v1,
-       x1, y0, z0,   bottom.u1, bottom.v1,
-       x1, y0, z1,   bottom.u1, bottom.v0,
-       x1, y0, z1,   bottom.u1, bottom.v0,
-       x0, y0, z1,   bottom.u0, bottom.v0,
-       x0, y0, z0,   bottom.u0, bottom.v1,
-
-
-       // Top face
-       x0, y1, z0,   top.u0, top.v1,
-       x1, y1, z0,   top.u1, top.v1,
-       x1, y1, z1,   top.u1, top.v0,
-       x1, y1, z1,   top.u1, top.v0,
-       x0, y1, z1,   top.u0, top.v0,
-       x0, y1, z0,   top.u0, top.v1
-   };
+// Cube faces, in the order their vertices were laid out in the original cube
+enum Face { FACE_BACK, FACE_FRONT, FACE_LEFT, FACE_RIGHT, FACE_BOTTOM, FACE_TOP };
+const char* faceNames[6] = { "back", "front", "left", "right", "bottom", "top" };
+const glm::ivec3 faceNormals[6] = {
+   glm::ivec3(0, 0, -1), glm::ivec3(0, 0, 1),
+   glm::ivec3(-1, 0, 0), glm::ivec3(1, 0, 0),
+   glm::ivec3(0, -1, 0), glm::ivec3(0, 1, 0)
+};
 
 
-   unsigned int VBO, VAO;
-   glGenVertexArrays(1, &VAO);
-   glGenBuffers(1, &VBO);
+// A chunk unpacked for meshing, plus the facing layer of each horizontal
+// neighbour so faces on the chunk border are culled against it. Layers are
+// indexed y * CHUNK_SIZE + (z for the x neighbours, x for the z neighbours);
+// neighbours that are not loaded read as air.
+enum NeighborSide { NEIGHBOR_NEG_X, NEIGHBOR_POS_X, NEIGHBOR_NEG_Z, NEIGHBOR_POS_Z };
 
 
-   glBindVertexArray(VAO);
-   glBindBuffer(GL_ARRAY_BUFFER, VBO);
-   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+struct MeshInput {
+   BlockType blocks[CHUNK_VOLUME];
+   BlockType neighbors[4][WORLD_HEIGHT * CHUNK_SIZE];
+   bool airSections[SECTIONS_PER_CHUNK];    // uniform air, skipped by the meshers
+   bool solidSections[SECTIONS_PER_CHUNK];  // one non-air type: only the boundary can have faces
+   bool empty;
+};
 
 
-   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+// Everything a meshing job reads: snapshots of the chunk and of its
+// neighbours in NeighborSide order (null where none is loaded)
+struct MeshSnapshot {
+   std::shared_ptr<const ChunkData> chunk;
+   std::shared_ptr<const ChunkData> neighbors[4];
+};
+
+
+MeshSnapshot captureMeshSnapshot(const Chunk& chunk) {
+   const Chunk* neighbors[4] = {
+       world.find(chunk.cx - 1, chunk.cz), world.find(chunk.cx + 1, chunk.cz),
+       world.find(chunk.cx, chunk.cz - 1), world.find(chunk.cx, chunk.cz + 1)
+   };
+   MeshSnapshot snapshot;
+   snapshot.chunk = chunk.data;
+   for (int side = 0; side < 4; side++) {
+       if (neighbors[side]) snapshot.neighbors[side] = neighbors[side]->data;
+   }
+   return snapshot;
+}
+
+
+void fillMeshInput(const MeshSnapshot& snapshot, MeshInput& input) {
+   const ChunkData& data = *snapshot.chunk;
+   input.empty = data.isEmpty();
+   for (int s = 0; s < SECTIONS_PER_CHUNK; s++) {
+       input.airSections[s] = data.sections[s].isUniform() && data.sections[s].palette[0] == AIR;
+       input.solidSections[s] = data.sections[s].isUniform() && data.sections[s].palette[0] != AIR;
+   }
+   if (input.empty) return;
+
+
+   data.unpack(input.blocks);
+
+
+   for (int side = 0; side < 4; side++) {
+       BlockType* layer = input.neighbors[side];
+       const ChunkData* neighbor = snapshot.neighbors[side].get();
+       for (int y = 0; y < WORLD_HEIGHT; y++) {
+           for (int i = 0; i < CHUNK_SIZE; i++) {
+               BlockType type = AIR;
+               if (neighbor) {
+                   switch(side) {
+                       case NEIGHBOR_NEG_X: type = neighbor->get(CHUNK_SIZE - 1, y, i); break;
+                       case NEIGHBOR_POS_X: type = neighbor->get(0, y, i); break;
+                       case NEIGHBOR_NEG_Z: type = neighbor->get(i, y, CHUNK_SIZE - 1); break;
+                       case NEIGHBOR_POS_Z: type = neighbor->get(i, y, 0); break;
+                   }
+               }
+               layer[y * CHUNK_SIZE + i] = type;
+           }
+       }
+   }
+}
+
+
+// Looks up a block of the chunk being meshed or of its neighbour layers.
+// Only positions at most one block outside the chunk on one axis are valid.
+BlockType blockAt(const MeshInput& input, int x, int y, int z) {
+   if (y < 0 || y >= WORLD_HEIGHT) return AIR;
+   if (x < 0) return input.neighbors[NEIGHBOR_NEG_X][y * CHUNK_SIZE + z];
+   if (x >= CHUNK_SIZE) return input.neighbors[NEIGHBOR_POS_X][y * CHUNK_SIZE + z];
+   if (z < 0) return input.neighbors[NEIGHBOR_NEG_Z][y * CHUNK_SIZE + x];
+   if (z >= CHUNK_SIZE) return input.neighbors[NEIGHBOR_POS_Z][y * CHUNK_SIZE + x];
+   return input.blocks[blockIndex(x, y, z)];
+}
+
+
+void pushVertex(std::vector<ChunkVertex>& vertices, int x, int y, int z, Face face, BlockType type) {
+   vertices.push_back(x | y << 5 | z << 12 | face << 17 | (ChunkVertex)type << 20);
+}
+
+
+// Appends a face covering sx * sy * sz blocks starting at (x, y, z), as its
+// four corners in quad order (triangles 0-1-2 and 2-3-0). Texture coordinates
+// follow the position, so merged faces repeat the tile.
+void appendFace(std::vector<ChunkVertex>& vertices, int x, int y, int z, BlockType type, Face face,
+                int sx = 1, int sy = 1, int sz = 1) {
+   int x0 = x;
+   int x1 = x + sx;
+   int y0 = y;
+   int y1 = y + sy;
+   int z0 = z;
+   int z1 = z + sz;
+
+
+   switch(face) {
+       case FACE_BACK:
+           pushVertex(vertices, x0, y0, z0, face, type);
+           pushVertex(vertices, x1, y0, z0, face, type);
+           pushVertex(vertices, x1, y1, z0, face, type);
+           pushVertex(vertices, x0, y1, z0, face, type);
+           break;
+       case FACE_FRONT:
+           pushVertex(vertices, x0, y0, z1, face, type);
+           pushVertex(vertices, x1, y0, z1, face, type);
+           pushVertex(vertices, x1, y1, z1, face, type);
+           pushVertex(vertices, x0, y1, z1, face, type);
+           break;
+       case FACE_LEFT:
+           pushVertex(vertices, x0, y1, z1, face, type);
+           pushVertex(vertices, x0, y1, z0, face, type);
+           pushVertex(vertices, x0, y0, z0, face, type);
+           pushVertex(vertices, x0, y0, z1, face, type);
+           break;
+       case FACE_RIGHT:
+           pushVertex(vertices, x1, y1, z1, face, type);
+           pushVertex(vertices, x1, y1, z0, face, type);
+           pushVertex(vertices, x1, y0, z0, face, type);
+           pushVertex(vertices, x1, y0, z1, face, type);
+           break;
+       case FACE_BOTTOM:
+           pushVertex(vertices, x0, y0, z0, face, type);
+           pushVertex(vertices, x1, y0, z0, face, type);
+           pushVertex(vertices, x1, y0, z1, face, type);
+           pushVertex(vertices, x0, y0, z1, face, type);
+           break;
+       case FACE_TOP:
+           pushVertex(vertices, x0, y1, z0, face, type);
+           pushVertex(vertices, x1, y1, z0, face, type);
+           pushVertex(vertices, x1, y1, z1, face, type);
+           pushVertex(vertices, x0, y1, z1, face, type);
+           break;
+   }
+}
+
+
+// Step along a row of x for the per-block meshers. A block type never shows a
+// face to itself, so inside a section of one type only the two ends of a row
+// that is not on the section's boundary can have faces.
+int interiorRowStep(const MeshInput& input, int y, int z) {
+   if (!input.solidSections[y / SECTION_SIZE]) return 1;
+   int layer = y % SECTION_SIZE;
+   bool edgeRow = layer == 0 || layer == SECTION_SIZE - 1 || z == 0 || z == CHUNK_SIZE - 1;
+   return edgeRow ? 1 : CHUNK_SIZE - 1;
+}
+
+
+// Emits only the faces of blocks matching the pass that border air or glass.
+void meshBlocks(const MeshInput& input, std::vector<ChunkVertex>& vertices, ChunkMesh& mesh, bool transparentPass) {
+   for (int y = 0; y < WORLD_HEIGHT; y++) {
+       if (input.airSections[y / SECTION_SIZE]) continue;
+       for (int z = 0; z < CHUNK_SIZE; z++) {
+           int step = interiorRowStep(input, y, z);
+           for (int x = 0; x < CHUNK_SIZE; x += step) {
+               BlockType type = input.blocks[blockIndex(x, y, z)];
+               if (type == AIR || (type == GLASS) != transparentPass) continue;
+
+
+               mesh.totalFaces += 6 * (x == 0 ? step : 1);  // skipped blocks still count
+               for (int f = 0; f < 6; f++) {
+                   glm::ivec3 n = faceNormals[f];
+                   if (isFaceVisible(type, blockAt(input, x + n.x, y + n.y, z + n.z))) {
+                       appendFace(vertices, x, y, z, type, (Face)f);
+                       mesh.emittedFaces++;
+                   }
+               }
+           }
+       }
+   }
+}
+
+
+// Same visibility rules as meshBlocks(), but each slice of visible faces is
+// merged into the largest rectangles of a single block type before emitting.
+void meshBlocksGreedy(const MeshInput& input, std::vector<ChunkVertex>& vertices, ChunkMesh& mesh, bool transparentPass) {
+   const int dims[3] = { CHUNK_SIZE, WORLD_HEIGHT, CHUNK_SIZE };
+   const int strides[3] = { 1, CHUNK_SIZE * CHUNK_SIZE, CHUNK_SIZE };  // blockIndex() steps along x, y, z
+   // Visible faces per direction in blockIndex() order. Merging clears every
+   // face it uses, so the masks are all air between calls.
+   static thread_local BlockType masks[6][CHUNK_VOLUME];
+   uint64_t slicesWithFaces[6] = {};
+
+
+   // Same walk as meshBlocks(), so air sections and section interiors are skipped
+   for (int y = 0; y < WORLD_HEIGHT; y++) {
+       if (input.airSections[y / SECTION_SIZE]) continue;
+       for (int z = 0; z < CHUNK_SIZE; z++) {
+           int step = interiorRowStep(input, y, z);
+           for (int x = 0; x < CHUNK_SIZE; x += step) {
+               BlockType type = input.blocks[blockIndex(x, y, z)];
+               if (type == AIR || (type == GLASS) != transparentPass) continue;
+
+
+               mesh.totalFaces += 6 * (x == 0 ? step : 1);  // skipped blocks still count
+               const int slices[6] = { z, z, x, x, y, y };  // position along each face's normal
+               for (int f = 0; f < 6; f++) {
+                   glm::ivec3 n = faceNormals[f];
+                   if (!isFaceVisible(type, blockAt(input, x + n.x, y + n.y, z + n.z))) continue;
+                   masks[f][blockIndex(x, y, z)] = type;
+                   slicesWithFaces[f] |= 1ULL << slices[f];
+               }
+           }
+       }
+   }
+
+
+   for (int f = 0; f < 6; f++) {
+       glm::ivec3 n = faceNormals[f];
+       int d = n.x != 0 ? 0 : (n.y != 0 ? 1 : 2);
+       int u = (d + 1) % 3;
+       int v = (d + 2) % 3;
+
+
+       for (uint64_t bits = slicesWithFaces[f]; bits; bits &= bits - 1) {
+           int slice = __builtin_ctzll(bits);
+           BlockType* mask = masks[f] + slice * strides[d];
+           auto cell = [&](int i, int j) -> BlockType& { return mask[i * strides[u] + j * strides[v]]; };
+
+
+           for (int j = 0; j < dims[v]; j++) {
+               for (int i = 0; i < dims[u]; ) {
+                   BlockType type = cell(i, j);
+                   if (type == AIR) {
+                       i++;
+                       continue;
+                   }
+
+
+                   int w = 1;
+                   while (i + w < dims[u] && cell(i + w, j) == type) w++;
+
+
+                   int h = 1;
+                   for (; j + h < dims[v]; h++) {
+                       bool rowMatches = true;
+                       for (int k = 0; k < w; k++) {
+                           if (cell(i + k, j + h) != type) {
+                               rowMatches = false;
+                               break;
+                           }
+                       }
+                       if (!rowMatches) break;
+                   }
+
+
+                   for (int l = 0; l < h; l++) {
+                       for (int k = 0; k < w; k++) {
+                           cell(i + k, j + l) = AIR;
+                       }
+                   }
+
+
+                   glm::ivec3 pos, size(1, 1, 1);
+                   pos[d] = slice;
+                   pos[u] = i;
+                   pos[v] = j;
+                   size[u] = w;
+                   size[v] = h;
+                   appendFace(vertices, pos.x, pos.y, pos.z, type, (Face)f, size.x, size.y, size.z);
+                   mesh.emittedFaces += w * h;
+                   i += w;
+               }
+           }
+       }
+   }
+}
+
+
+// Every column of the chunk along each axis packed into a 64-bit mask, once
+// for blocks of any kind and once for opaque ones. Columns are indexed
+// a + b * dims[u] with u = (d + 1) % 3 and v = (d + 2) % 3, bit = position on d.
+struct ColumnMasks {
+   uint64_t solid[3][CHUNK_SIZE * WORLD_HEIGHT];
+   uint64_t opaque[3][CHUNK_SIZE * WORLD_HEIGHT];
+   int opaqueBlocks;
+   int glassBlocks;
+};
+
+
+void buildColumnMasks(const MeshInput& input, ColumnMasks& columns) {
+   static_assert(CHUNK_SIZE <= 64 && WORLD_HEIGHT <= 64, "columns must fit in a 64-bit mask");
+   memset(&columns, 0, sizeof(columns));
+   uint64_t* solid[3] = { columns.solid[0], columns.solid[1], columns.solid[2] };
+   uint64_t* opaque[3] = { columns.opaque[0], columns.opaque[1], columns.opaque[2] };
+   const uint64_t row = (1ULL << CHUNK_SIZE) - 1;
+
+
+   for (int section = 0; section < SECTIONS_PER_CHUNK; section++) {
+       if (input.airSections[section]) continue;
+       int y0 = section * SECTION_SIZE;
+
+
+       // A single-type section fills its whole range of every column
+       if (input.solidSections[section]) {
+           bool glass = input.blocks[blockIndex(0, y0, 0)] == GLASS;
+           (glass ? columns.glassBlocks : columns.opaqueBlocks) += SECTION_VOLUME;
+           uint64_t span = ((1ULL << SECTION_SIZE) - 1) << y0;
+           for (int y = y0; y < y0 + SECTION_SIZE; y++) {
+               for (int i = 0; i < CHUNK_SIZE; i++) {
+                   solid[0][y + i * WORLD_HEIGHT] = row;
+                   solid[2][i + y * CHUNK_SIZE] = row;
+                   if (!glass) {
+                       opaque[0][y + i * WORLD_HEIGHT] = row;
+                       opaque[2][i + y * CHUNK_SIZE] = row;
+                   }
+               }
+           }
+           for (int i = 0; i < CHUNK_SIZE * CHUNK_SIZE; i++) {
+               solid[1][i] |= span;
+               if (!glass) opaque[1][i] |= span;
+           }
+           continue;
+       }
+
+
+       for (int y = y0; y < y0 + SECTION_SIZE; y++) {
+           for (int z = 0; z < CHUNK_SIZE; z++) {
+               const BlockType* blocks = &input.blocks[blockIndex(0, y, z)];
+               uint64_t solidRow = 0, glassRow = 0;
+#ifdef __SSE2__
+               // One byte compare per row: the sign bits are the masks
+               static_assert(CHUNK_SIZE == 16 && sizeof(BlockType) == 1, "rows must fill one SSE register");
+               __m128i row = _mm_loadu_si128((const __m128i*)blocks);
+               solidRow = ~_mm_movemask_epi8(_mm_cmpeq_epi8(row, _mm_setzero_si128())) & 0xffff;
+               glassRow = _mm_movemask_epi8(_mm_cmpeq_epi8(row, _mm_set1_epi8(GLASS)));
+#else
+               for (int x = 0; x < CHUNK_SIZE; x++) {
+                   solidRow |= (uint64_t)(blocks[x] != AIR) << x;
+                   glassRow |= (uint64_t)(blocks[x] == GLASS) << x;
+               }
+#endif
+               if (!solidRow) continue;
+               uint64_t opaqueRow = solidRow & ~glassRow;
+               columns.opaqueBlocks += __builtin_popcountll(opaqueRow);
+               columns.glassBlocks += __builtin_popcountll(glassRow);
+               solid[0][y + z * WORLD_HEIGHT] = solidRow;
+               opaque[0][y + z * WORLD_HEIGHT] = opaqueRow;
+
+
+               // Scatter the row's set bits into the y and z columns
+               for (uint64_t bits = solidRow; bits; bits &= bits - 1) {
+                   int x = __builtin_ctzll(bits);
+                   uint64_t isOpaque = opaqueRow >> x & 1;
+                   solid[1][z + x * CHUNK_SIZE] |= 1ULL << y;
+                   opaque[1][z + x * CHUNK_SIZE] |= isOpaque << y;
+                   solid[2][x + y * CHUNK_SIZE] |= 1ULL << z;
+                   opaque[2][x + y * CHUNK_SIZE] |= isOpaque << z;
+               }
+           }
+       }
+   }
+}
+
+
+// Bitmask variant of meshBlocksGreedy(). Visible faces of a whole column fall
+// out of a shift and an AND on the column masks; only their set bits are
+// looked up and sorted by block type, and merging walks set bits with
+// count-trailing-zeros instead of visiting every voxel of every slice.
+void meshBlocksBinary(const MeshInput& input, const ColumnMasks& columns, std::vector<ChunkVertex>& vertices,
+                      ChunkMesh& mesh, bool transparentPass) {
+   mesh.totalFaces += 6 * (transparentPass ? columns.glassBlocks : columns.opaqueBlocks);
+   if ((transparentPass ? columns.glassBlocks : columns.opaqueBlocks) == 0) return;
+   const int dims[3] = { CHUNK_SIZE, WORLD_HEIGHT, CHUNK_SIZE };
+   const int strides[3] = { 1, CHUNK_SIZE * CHUNK_SIZE, CHUNK_SIZE };  // of blockIndex() per axis
+   const Face negativeFaces[3] = { FACE_LEFT, FACE_BOTTOM, FACE_BACK };
+   const Face positiveFaces[3] = { FACE_RIGHT, FACE_TOP, FACE_FRONT };
+
+
+   // Visible faces sorted into planes: [type][slice][row], one bit per column.
+   // Merging clears every bit it consumes, so the planes are all zero again
+   // when a direction is done and never need clearing. slicesWithType and
+   // rowsWithType track which planes and rows the direction touched.
+   static thread_local std::vector<uint64_t> planeStorage(BLOCK_TYPE_COUNT * 64 * 64);
+   uint64_t* planes = planeStorage.data();
+   uint64_t slicesWithType[BLOCK_TYPE_COUNT] = {};
+   uint64_t rowsWithType[BLOCK_TYPE_COUNT][64] = {};
+
+
+   for (int d = 0; d < 3; d++) {
+       int u = (d + 1) % 3;
+       int v = (d + 2) % 3;
+       const uint64_t* solid = columns.solid[d];
+       const uint64_t* opaque = columns.opaque[d];
+
+
+       for (int positive = 0; positive < 2; positive++) {
+           for (int b = 0; b < dims[v]; b++) {
+               for (int a = 0; a < dims[u]; a++) {
+                   // Blocks drawn in this pass, and blocks that hide their faces
+                   // (opaque blocks for the opaque pass, anything solid for glass)
+                   int c = a + b * dims[u];
+                   uint64_t column = transparentPass ? solid[c] & ~opaque[c] : opaque[c];
+                   if (!column) continue;
+                   uint64_t occ = transparentPass ? solid[c] : opaque[c];
+                   uint64_t visible = positive ? column & ~(occ >> 1) : column & ~(occ << 1);
+
+
+                   // Faces on the chunk border are hidden by the neighbour's facing layer
+                   if (d != 1 && visible) {
+                       int side = (d == 0 ? NEIGHBOR_NEG_X : NEIGHBOR_NEG_Z) + positive;
+                       int y = d == 0 ? a : b;
+                       int i = d == 0 ? b : a;
+                       BlockType neighbor = input.neighbors[side][y * CHUNK_SIZE + i];
+                       if (neighbor != AIR && (transparentPass || neighbor != GLASS)) {
+                           visible &= positive ? ~(1ULL << (CHUNK_SIZE - 1)) : ~1ULL;
+                       }
+                   }
+
+
+                   const BlockType* blocks = &input.blocks[a * strides[u] + b * strides[v]];
+                   while (visible) {
+                       int slice = __builtin_ctzll(visible);
+                       visible &= visible - 1;
+
+
+                       BlockType type = blocks[slice * strides[d]];
+                       planes[(type * 64 + slice) * 64 + b] |= 1ULL << a;
+                       slicesWithType[type] |= 1ULL << slice;
+                       rowsWithType[type][slice] |= 1ULL << b;
+                   }
+               }
+           }
+
+
+           Face face = positive ? positiveFaces[d] : negativeFaces[d];
+           for (int type = 0; type < BLOCK_TYPE_COUNT; type++) {
+               for (uint64_t slices = slicesWithType[type]; slices; slices &= slices - 1) {
+                   int slice = __builtin_ctzll(slices);
+                   uint64_t* rows = &planes[(type * 64 + slice) * 64];
+
+
+                   for (uint64_t rowBits = rowsWithType[type][slice]; rowBits; rowBits &= rowBits - 1) {
+                       int j = __builtin_ctzll(rowBits);
+                       while (rows[j]) {
+                           int i = __builtin_ctzll(rows[j]);
+                           uint64_t run = rows[j] >> i;
+                           int w = run == ~0ULL ? 64 : __builtin_ctzll(~run);
+                           uint64_t runMask = (w == 64 ? ~0ULL : ((1ULL << w) - 1)) << i;
+
+
+                           int h = 1;
+                           while (j + h < dims[v] && (rows[j + h] & runMask) == runMask) {
+                               rows[j + h] &= ~runMask;
+                               h++;
+                           }
+                           rows[j] &= ~runMask;
+
+
+                           glm::ivec3 pos, size(1, 1, 1);
+                           pos[d] = slice;
+                           pos[u] = i;
+                           pos[v] = j;
+                           size[u] = w;
+                           size[v] = h;
+                           appendFace(vertices, pos.x, pos.y, pos.z, (BlockType)type, face, size.x, size.y, size.z);
+                           mesh.emittedFaces += w * h;
+                       }
+                   }
+                   rowsWithType[type][slice] = 0;
+               }
+               slicesWithType[type] = 0;
+           }
+       }
+   }
+}
+
+
+// Instanced mode: one instance per block of the pass with any visible face.
+// The whole cube is drawn, so all six faces count as emitted.
+void meshBlocksInstanced(const MeshInput& input, std::vector<ChunkVertex>& instances, ChunkMesh& mesh, bool transparentPass) {
+   for (int y = 0; y < WORLD_HEIGHT; y++) {
+       if (input.airSections[y / SECTION_SIZE]) continue;
+       for (int z = 0; z < CHUNK_SIZE; z++) {
+           int step = interiorRowStep(input, y, z);
+           for (int x = 0; x < CHUNK_SIZE; x += step) {
+               BlockType type = input.blocks[blockIndex(x, y, z)];
+               if (type == AIR || (type == GLASS) != transparentPass) continue;
+
+
+               mesh.totalFaces += 6 * (x == 0 ? step : 1);  // skipped blocks still count
+               for (int f = 0; f < 6; f++) {
+                   glm::ivec3 n = faceNormals[f];
+                   if (isFaceVisible(type, blockAt(input, x + n.x, y + n.y, z + n.z))) {
+                       pushVertex(instances, x, y, z, (Face)0, type);
+                       mesh.emittedFaces += 6;
+                       break;
+                   }
+               }
+           }
+       }
+   }
+}
+
+
+// Flood fills the pocket of air and glass around blocks[start] of a section,
+// marking it in visited, and returns the section faces it touches as one bit
+// per Face
+int fillPocket(const BlockType* blocks, int start, bool* visited) {
+   uint16_t stack[SECTION_VOLUME];
+   int faces = 0;
+   int top = 0;
+   stack[top++] = start;
+   visited[start] = true;
+   while (top > 0) {
+       int i = stack[--top];
+       int x = i % SECTION_SIZE, z = i / SECTION_SIZE % SECTION_SIZE, y = i / (SECTION_SIZE * SECTION_SIZE);
+       if (z == 0) faces |= 1 << FACE_BACK;
+       if (z == SECTION_SIZE - 1) faces |= 1 << FACE_FRONT;
+       if (x == 0) faces |= 1 << FACE_LEFT;
+       if (x == SECTION_SIZE - 1) faces |= 1 << FACE_RIGHT;
+       if (y == 0) faces |= 1 << FACE_BOTTOM;
+       if (y == SECTION_SIZE - 1) faces |= 1 << FACE_TOP;
+
+
+       for (int f = 0; f < 6; f++) {
+           int nx = x + faceNormals[f].x, ny = y + faceNormals[f].y, nz = z + faceNormals[f].z;
+           if (nx < 0 || ny < 0 || nz < 0 || nx >= SECTION_SIZE || ny >= SECTION_SIZE || nz >= SECTION_SIZE) continue;
+           int n = (ny * SECTION_SIZE + nz) * SECTION_SIZE + nx;
+           if (visited[n] || (blocks[n] != AIR && blocks[n] != GLASS)) continue;
+           visited[n] = true;
+           stack[top++] = n;
+       }
+   }
+   return faces;
+}
+
+
+// Flood fills each pocket of air and glass in a section and connects every
+// pair of section faces the pocket touches
+uint64_t findSectionVisibility(const MeshInput& input, int section) {
+   if (input.airSections[section]) return ALL_FACES_CONNECTED;
+   if (input.solidSections[section]) {
+       BlockType type = input.blocks[blockIndex(0, section * SECTION_SIZE, 0)];
+       return type == GLASS ? ALL_FACES_CONNECTED : 0;
+   }
+
+
+   const BlockType* blocks = &input.blocks[blockIndex(0, section * SECTION_SIZE, 0)];
+   bool visited[SECTION_VOLUME] = {};
+   uint64_t visibility = 0;
+   for (int start = 0; start < SECTION_VOLUME; start++) {
+       if (visited[start] || (blocks[start] != AIR && blocks[start] != GLASS)) continue;
+
+
+       int faces = fillPocket(blocks, start, visited);
+       for (int a = 0; a < 6; a++) {
+           if (!(faces & 1 << a)) continue;
+           for (int b = 0; b < 6; b++) {
+               if (faces & 1 << b) visibility |= 1ULL << (a * 6 + b);
+           }
+       }
+   }
+   return visibility;
+}
+
+
+// Meshes an unpacked chunk with the current mesher. Opaque faces come first
+// and glass last so each pass is a single contiguous draw.
+void meshChunk(const MeshInput& input, std::vector<ChunkVertex>& vertices, ChunkMesh& mesh) {
+   vertices.clear();
+   mesh.emittedFaces = 0;
+   mesh.totalFaces = 0;
+   mesh.opaqueVertexCount = 0;
+   mesh.transparentVertexCount = 0;
+   mesh.minY = mesh.maxY = 0;
+   mesh.solidLayers = 0;
+   for (int section = 0; section < SECTIONS_PER_CHUNK; section++) {
+       mesh.sectionVisibility[section] = input.empty ? ALL_FACES_CONNECTED : findSectionVisibility(input, section);
+   }
+   if (input.empty) return;
+
+
+   // Bounds and occluders for occlusion culling
+   mesh.minY = WORLD_HEIGHT;
+   for (int y = 0; y < WORLD_HEIGHT; y++) {
+       if (input.airSections[y / SECTION_SIZE]) continue;
+       const BlockType* layer = &input.blocks[blockIndex(0, y, 0)];
+       int opaque = 0, filled = 0;
+       if (input.solidSections[y / SECTION_SIZE]) {
+           filled = CHUNK_SIZE * CHUNK_SIZE;
+           opaque = layer[0] == GLASS ? 0 : filled;
+       } else {
+           for (int i = 0; i < CHUNK_SIZE * CHUNK_SIZE; i++) {
+               filled += layer[i] != AIR;
+               opaque += layer[i] != AIR && layer[i] != GLASS;
+           }
+       }
+       if (filled == 0) continue;
+       mesh.minY = std::min(mesh.minY, y);
+       mesh.maxY = y + 1;
+       if (opaque == CHUNK_SIZE * CHUNK_SIZE) mesh.solidLayers |= 1ULL << y;
+   }
+
+
+   // The binary mesher's column masks serve both passes
+   static thread_local ColumnMasks columns;
+   if (mesherMode == MESHER_BINARY) buildColumnMasks(input, columns);
+
+
+   for (int pass = 0; pass < 2; pass++) {
+       bool transparentPass = pass == 1;
+       if (mesherMode == MESHER_GREEDY) meshBlocksGreedy(input, vertices, mesh, transparentPass);
+       else if (mesherMode == MESHER_BINARY) meshBlocksBinary(input, columns, vertices, mesh, transparentPass);
+       else if (mesherMode == MESHER_INSTANCED) meshBlocksInstanced(input, vertices, mesh, transparentPass);
+       else meshBlocks(input, vertices, mesh, transparentPass);
+
+
+       if (!transparentPass) mesh.opaqueVertexCount = vertices.size();
+   }
+   mesh.transparentVertexCount = vertices.size() - mesh.opaqueVertexCount;
+}
+
+
+// A mesh built by a worker, waiting for the main thread to upload it
+struct MeshResult {
+   int cx, cz;
+   uint64_t job;
+   ChunkMesh counts;  // face and vertex counts only, no GL objects
+   std::vector<ChunkVertex> vertices;
+   MeshResult* next;
+};
+
+
+// Lock-free handoff from the workers: they push results onto this stack and
+// the main thread takes the whole list in one exchange
+std::atomic<MeshResult*> finishedMeshes{nullptr};
+const size_t MESH_UPLOAD_BUDGET_BYTES = 4 << 20;
+std::vector<MeshResult*> meshUploads;
+
+
+void pushFinishedMesh(MeshResult* result) {
+   result->next = finishedMeshes.load(std::memory_order_relaxed);
+   while (!finishedMeshes.compare_exchange_weak(result->next, result, std::memory_order_release, std::memory_order_relaxed)) {}
+}
+
+
+MeshResult* takeFinishedMeshes() {
+   return finishedMeshes.exchange(nullptr, std::memory_order_acquire);
+}
+
+
+// One element buffer with the 0-1-2-2-3-0 quad pattern, shared by every
+// chunk VAO. It grows to fit the largest mesh seen; reallocating it keeps
+// the same buffer name, so VAOs that reference it stay valid.
+unsigned int quadIndexBuffer = 0;
+size_t quadIndexCapacity = 0;  // in quads
+
+
+void reserveQuadIndices(size_t quads) {
+   if (quads <= quadIndexCapacity) return;
+   quadIndexCapacity = std::max(quads, std::max<size_t>(quadIndexCapacity * 2, 16384));
+
+
+   std::vector<uint32_t> indices;
+   indices.reserve(quadIndexCapacity * INDICES_PER_FACE);
+   for (uint32_t base = 0; base < quadIndexCapacity * VERTICES_PER_FACE; base += VERTICES_PER_FACE) {
+       uint32_t quad[] = { base, base + 1, base + 2, base + 2, base + 3, base };
+       indices.insert(indices.end(), std::begin(quad), std::end(quad));
+   }
+
+
+   // Uploaded through the copy binding so no VAO's element binding changes
+   if (quadIndexBuffer == 0) callGL(glGenBuffers, 1, &quadIndexBuffer);
+   callGL(glBindBuffer, GL_COPY_WRITE_BUFFER, quadIndexBuffer);
+   callGL(glBufferData, GL_COPY_WRITE_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+   callGL(glBindBuffer, GL_COPY_WRITE_BUFFER, 0);
+}
+
+
+// Unit cube drawn once per instance in instanced mode, as six quads
+unsigned int cubeVBO = 0;
+
+
+void initCube() {
+   std::vector<ChunkVertex> corners;
+   for (int f = 0; f < 6; f++) appendFace(corners, 0, 0, 0, AIR, (Face)f);
+
+
+   callGL(glGenBuffers, 1, &cubeVBO);
+   callGL(glBindBuffer, GL_ARRAY_BUFFER, cubeVBO);
+   callGL(glBufferData, GL_ARRAY_BUFFER, corners.size() * sizeof(ChunkVertex), corners.data(), GL_STATIC_DRAW);
+   callGL(glBindBuffer, GL_ARRAY_BUFFER, 0);
+}
+
+
+// Points a VAO at the cube's corners and at mesh.VBO's instances from firstInstance on
+void setupInstanceArrays(unsigned int vertexArray, unsigned int instanceBuffer, int firstInstance) {
+   bindVertexArray(vertexArray);
+   callGL(glBindBuffer, GL_ELEMENT_ARRAY_BUFFER, quadIndexBuffer);
+   callGL(glBindBuffer, GL_ARRAY_BUFFER, cubeVBO);
+   callGL(glVertexAttribIPointer, 0, 1, GL_UNSIGNED_INT, sizeof(ChunkVertex), (void*)0);
+   callGL(glEnableVertexAttribArray, 0);
+
+
+   callGL(glBindBuffer, GL_ARRAY_BUFFER, instanceBuffer);
+   callGL(glVertexAttribIPointer, 1, 1, GL_UNSIGNED_INT, sizeof(ChunkVertex), (void*)(firstInstance * sizeof(ChunkVertex)));
+   callGL(glVertexAttribDivisor, 1, 1);
+   callGL(glEnableVertexAttribArray, 1);
+}
+
+
+void uploadInstancedMesh(ChunkMesh& mesh, const std::vector<ChunkVertex>& instances) {
+   reserveQuadIndices(6);
+   if (mesh.VAO == 0) {
+       callGL(glGenVertexArrays, 1, &mesh.VAO);
+       callGL(glGenVertexArrays, 1, &mesh.transparentVAO);
+       callGL(glGenBuffers, 1, &mesh.VBO);
+       setupInstanceArrays(mesh.VAO, mesh.VBO, 0);
+   }
+   callGL(glBindBuffer, GL_ARRAY_BUFFER, mesh.VBO);
+   callGL(glBufferData, GL_ARRAY_BUFFER, instances.size() * sizeof(ChunkVertex), instances.data(), GL_STATIC_DRAW);
+
+
+   // The glass instances follow the opaque ones, wherever that boundary moved to
+   setupInstanceArrays(mesh.transparentVAO, mesh.VBO, mesh.opaqueVertexCount);
+}
+
+
+// All chunk meshes share one vertex buffer, handed out in pages of
+// ARENA_PAGE_VERTICES. The vertex shader finds the chunk a vertex belongs to
+// from its page, through a buffer texture of chunk origins, so every visible
+// chunk can go out in a single multi-draw. Growing the arena keeps the buffer
+// names, so the VAO and the texture stay valid.
+const int ARENA_PAGE_SHIFT = 10;
+const int ARENA_PAGE_VERTICES = 1 << ARENA_PAGE_SHIFT;
+
+struct VertexArena {
+   unsigned int VAO = 0, VBO = 0;
+   unsigned int originBuffer = 0, originTexture = 0;
+   unsigned int indirectBuffer = 0;
+   int pageCount = 0;
+   std::vector<std::pair<int, int>> freeRanges;  // (first page, page count), sorted
+   std::vector<glm::vec2> origins;               // chunk x and z in blocks, per page
+};
+VertexArena vertexArena;
+
+
+void growVertexArena(int minimumPages) {
+   VertexArena& arena = vertexArena;
+   int oldPages = arena.pageCount;
+   int newPages = std::max({ oldPages * 2, oldPages + minimumPages, 256 });
+   size_t oldBytes = (size_t)oldPages * ARENA_PAGE_VERTICES * sizeof(ChunkVertex);
+   size_t newBytes = (size_t)newPages * ARENA_PAGE_VERTICES * sizeof(ChunkVertex);
+
+
+   if (arena.VAO == 0) {
+       callGL(glGenVertexArrays, 1, &arena.VAO);
+       callGL(glGenBuffers, 1, &arena.VBO);
+       callGL(glGenBuffers, 1, &arena.originBuffer);
+       callGL(glGenTextures, 1, &arena.originTexture);
+       callGL(glGenBuffers, 1, &arena.indirectBuffer);
+   }
+
+
+   // Park the old vertices in a scratch buffer while the arena is reallocated
+   unsigned int scratch = 0;
+   if (oldBytes > 0) {
+       callGL(glGenBuffers, 1, &scratch);
+       callGL(glBindBuffer, GL_COPY_WRITE_BUFFER, scratch);
+       callGL(glBufferData, GL_COPY_WRITE_BUFFER, oldBytes, nullptr, GL_STREAM_COPY);
+       callGL(glBindBuffer, GL_COPY_READ_BUFFER, arena.VBO);
+       callGL(glCopyBufferSubData, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldBytes);
+   }
+   callGL(glBindBuffer, GL_COPY_READ_BUFFER, arena.VBO);
+   callGL(glBufferData, GL_COPY_READ_BUFFER, newBytes, nullptr, GL_STATIC_DRAW);
+   if (scratch != 0) {
+       callGL(glBindBuffer, GL_COPY_READ_BUFFER, scratch);
+       callGL(glBindBuffer, GL_COPY_WRITE_BUFFER, arena.VBO);
+       callGL(glCopyBufferSubData, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldBytes);
+       callGL(glDeleteBuffers, 1, &scratch);
+   }
+   callGL(glBindBuffer, GL_COPY_READ_BUFFER, 0);
+   callGL(glBindBuffer, GL_COPY_WRITE_BUFFER, 0);
+
+
+   if (oldPages == 0) {
+       bindVertexArray(arena.VAO);
+       callGL(glBindBuffer, GL_ARRAY_BUFFER, arena.VBO);
+       callGL(glBindBuffer, GL_ELEMENT_ARRAY_BUFFER, quadIndexBuffer);
+       callGL(glVertexAttribIPointer, 0, 1, GL_UNSIGNED_INT, sizeof(ChunkVertex), (void*)0);
+       callGL(glEnableVertexAttribArray, 0);
+   }
+   arena.origins.resize(newPages);
+   callGL(glBindBuffer, GL_TEXTURE_BUFFER, arena.originBuffer);
+   callGL(glBufferData, GL_TEXTURE_BUFFER, arena.origins.size() * sizeof(glm::vec2), arena.origins.data(), GL_DYNAMIC_DRAW);
+   callGL(glBindBuffer, GL_TEXTURE_BUFFER, 0);
+   if (oldPages == 0) {
+       // Unit 1 holds the origins for the whole run; unit 0 stays the atlas
+       callGL(glActiveTexture, GL_TEXTURE1);
+       callGL(glBindTexture, GL_TEXTURE_BUFFER, arena.originTexture);
+       callGL(glTexBuffer, GL_TEXTURE_BUFFER, GL_RG32F, arena.originBuffer);
+       callGL(glActiveTexture, GL_TEXTURE0);
+   }
+
+
+   arena.pageCount = newPages;
+   if (!arena.freeRanges.empty() && arena.freeRanges.back().first + arena.freeRanges.back().second == oldPages) {
+       arena.freeRanges.back().second += newPages - oldPages;
+   } else {
+       arena.freeRanges.push_back({ oldPages, newPages - oldPages });
+   }
+}
+
+
+// First fit, growing the arena when no free range is large enough
+int allocatePages(int count) {
+   std::vector<std::pair<int, int>>& ranges = vertexArena.freeRanges;
+   for (int attempt = 0; attempt < 2; attempt++) {
+       for (size_t i = 0; i < ranges.size(); i++) {
+           if (ranges[i].second < count) continue;
+           int first = ranges[i].first;
+           ranges[i].first += count;
+           ranges[i].second -= count;
+           if (ranges[i].second == 0) ranges.erase(ranges.begin() + i);
+           return first;
+       }
+       growVertexArena(count);
+   }
+   return -1;
+}
+
+
+void freePages(int first, int count) {
+   std::vector<std::pair<int, int>>& ranges = vertexArena.freeRanges;
+   auto next = std::lower_bound(ranges.begin(), ranges.end(), std::make_pair(first, 0));
+   next = ranges.insert(next, { first, count });
+   if (next + 1 != ranges.end() && next->first + next->second == (next + 1)->first) {
+       next->second += (next + 1)->second;
+       ranges.erase(next + 1);
+   }
+   if (next != ranges.begin() && (next - 1)->first + (next - 1)->second == next->first) {
+       (next - 1)->second += next->second;
+       ranges.erase(next);
+   }
+}
+
+
+void uploadArenaMesh(ChunkMesh& mesh, int cx, int cz, const std::vector<ChunkVertex>& vertices) {
+   int pages = (vertices.size() + ARENA_PAGE_VERTICES - 1) >> ARENA_PAGE_SHIFT;
+
+
+   // Keep the pages while the mesh still fits them without wasting half
+   if (pages > mesh.pageCount || pages < mesh.pageCount / 2) {
+       if (mesh.firstPage >= 0) freePages(mesh.firstPage, mesh.pageCount);
+       mesh.firstPage = pages > 0 ? allocatePages(pages) : -1;
+       mesh.pageCount = pages;
+
+
+       glm::vec2 origin(cx * CHUNK_SIZE, cz * CHUNK_SIZE);
+       if (pages > 0) {
+           std::fill_n(vertexArena.origins.begin() + mesh.firstPage, pages, origin);
+           callGL(glBindBuffer, GL_TEXTURE_BUFFER, vertexArena.originBuffer);
+           callGL(glBufferSubData, GL_TEXTURE_BUFFER, mesh.firstPage * sizeof(glm::vec2), pages * sizeof(glm::vec2), &vertexArena.origins[mesh.firstPage]);
+           callGL(glBindBuffer, GL_TEXTURE_BUFFER, 0);
+       }
+   }
+   if (vertices.empty()) return;
+
+
+   callGL(glBindBuffer, GL_ARRAY_BUFFER, vertexArena.VBO);
+   callGL(glBufferSubData, GL_ARRAY_BUFFER, (size_t)mesh.firstPage * ARENA_PAGE_VERTICES * sizeof(ChunkVertex),
+                   vertices.size() * sizeof(ChunkVertex), vertices.data());
+}
+
+
+void uploadChunkMesh(ChunkMesh& mesh, const MeshResult& result) {
+   mesh.opaqueVertexCount = result.counts.opaqueVertexCount;
+   mesh.transparentVertexCount = result.counts.transparentVertexCount;
+   mesh.emittedFaces = result.counts.emittedFaces;
+   mesh.totalFaces = result.counts.totalFaces;
+   mesh.minY = result.counts.minY;
+   mesh.maxY = result.counts.maxY;
+   mesh.solidLayers = result.counts.solidLayers;
+   std::copy(std::begin(result.counts.sectionVisibility), std::end(result.counts.sectionVisibility), mesh.sectionVisibility);
+   const std::vector<ChunkVertex>& vertices = result.vertices;
+
+
+   if (mesherMode == MESHER_INSTANCED) {
+       // All-air chunks never need GPU buffers
+       if (vertices.empty() && mesh.VAO == 0) return;
+       uploadInstancedMesh(mesh, vertices);
+       return;
+   }
+
+
+   reserveQuadIndices(vertices.size() / VERTICES_PER_FACE);
+   uploadArenaMesh(mesh, result.cx, result.cz, vertices);
+}
+
+
+// Instanced mode only; the other meshers draw through drawArenaMeshes.
+// Blend and polygon mode are set once per pass by the caller.
+void drawChunkMesh(const ChunkMesh& mesh, bool transparentPass) {
+   int instances = transparentPass ? mesh.transparentVertexCount : mesh.opaqueVertexCount;
+   if (instances == 0) return;
+   bindVertexArray(transparentPass ? mesh.transparentVAO : mesh.VAO);
+   callGL(glDrawElementsInstanced, GL_TRIANGLES, 6 * INDICES_PER_FACE, GL_UNSIGNED_INT, nullptr, instances);
+   glState.draws++;
+   glState.drawnMeshes++;
+}
+
+
+// Draws one pass of every chunk in the arena with a single multi-draw
+void drawArenaMeshes(const std::vector<const Chunk*>& chunks, bool transparentPass) {
+   struct DrawCommand {
+       uint32_t count;
+       uint32_t instanceCount;
+       uint32_t firstIndex;
+       int32_t baseVertex;
+       uint32_t baseInstance;
+   };
+   static std::vector<DrawCommand> commands;
+   static std::vector<GLsizei> counts;
+   static std::vector<const void*> offsets;
+   static std::vector<GLint> baseVertices;
+   commands.clear();
+   counts.clear();
+   offsets.clear();
+   baseVertices.clear();
+
+
+   for (const Chunk* chunk : chunks) {
+       const ChunkMesh& mesh = chunk->mesh;
+       int first = (transparentPass ? mesh.opaqueVertexCount : 0) / VERTICES_PER_FACE * INDICES_PER_FACE;
+       int count = (transparentPass ? mesh.transparentVertexCount : mesh.opaqueVertexCount) / VERTICES_PER_FACE * INDICES_PER_FACE;
+       if (count == 0 || mesh.firstPage < 0) continue;
+       int baseVertex = mesh.firstPage * ARENA_PAGE_VERTICES;
+       if (multiDrawIndirect) {
+           commands.push_back({ (uint32_t)count, 1, (uint32_t)first, baseVertex, 0 });
+       } else {
+           counts.push_back(count);
+           offsets.push_back((const void*)(first * sizeof(uint32_t)));
+           baseVertices.push_back(baseVertex);
+       }
+   }
+   int drawCount = multiDrawIndirect ? commands.size() : counts.size();
+   if (drawCount == 0) return;
+
+
+   bindVertexArray(vertexArena.VAO);
+   if (multiDrawIndirect) {
+       callGL(glBindBuffer, GL_DRAW_INDIRECT_BUFFER, vertexArena.indirectBuffer);
+       callGL(glBufferData, GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawCommand), commands.data(), GL_STREAM_DRAW);
+       callGL(glMultiDrawElementsIndirect, GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, drawCount, 0);
+   } else {
+       callGL(glMultiDrawElementsBaseVertex, GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(), drawCount, baseVertices.data());
+   }
+   glState.draws++;
+   glState.drawnMeshes += drawCount;
+}
+
+
+void destroyVertexArena() {
+   VertexArena& arena = vertexArena;
+   if (arena.VAO == 0) return;
+   if (glState.vertexArray == arena.VAO) glState.vertexArray = 0;
+   callGL(glDeleteVertexArrays, 1, &arena.VAO);
+   callGL(glDeleteBuffers, 1, &arena.VBO);
+   callGL(glDeleteBuffers, 1, &arena.originBuffer);
+   callGL(glDeleteBuffers, 1, &arena.indirectBuffer);
+   callGL(glDeleteTextures, 1, &arena.originTexture);
+   arena = VertexArena();
+}
+
+
+void destroyChunkMesh(ChunkMesh& mesh) {
+   if (mesh.firstPage >= 0) {
+       freePages(mesh.firstPage, mesh.pageCount);
+       mesh.firstPage = -1;
+       mesh.pageCount = 0;
+   }
+   if (mesh.VAO != 0) {
+       if (glState.vertexArray == mesh.VAO || glState.vertexArray == mesh.transparentVAO) glState.vertexArray = 0;
+       callGL(glDeleteVertexArrays, 1, &mesh.VAO);
+       callGL(glDeleteVertexArrays, 1, &mesh.transparentVAO);
+       callGL(glDeleteBuffers, 1, &mesh.VBO);
+       mesh.VAO = mesh.VBO = mesh.transparentVAO = 0;
+   }
+}
+
+
+// The six clip planes of projection * view as (normal, distance), normals
+// pointing inwards. Only the sign of the distance is tested, so the planes
+// are left unnormalised.
+struct Frustum {
+   glm::vec4 planes[6];
+};
+
+
+Frustum extractFrustum(const glm::mat4& viewProjection) {
+   glm::mat4 rows = glm::transpose(viewProjection);
+   Frustum frustum;
+   for (int axis = 0; axis < 3; axis++) {
+       frustum.planes[axis * 2] = rows[3] + rows[axis];
+       frustum.planes[axis * 2 + 1] = rows[3] - rows[axis];
+   }
+   return frustum;
+}
+
+
+// Software occlusion culling. The solid layers of the chunks in the frustum
+// are drawn as boxes into a small depth buffer on the CPU, which is reduced
+// into a pyramid holding the farthest depth under each texel. A chunk is
+// skipped when the nearest corner of its bounds is behind every texel its
+// screen rectangle touches.
+const int OCCLUSION_WIDTH = 256;
+const int OCCLUSION_HEIGHT = 128;
+const int OCCLUSION_LEVELS = 7;
+static_assert(OCCLUSION_WIDTH % 4 == 0, "occlusion rows are rasterized four pixels at a time");
+static_assert((OCCLUSION_HEIGHT >> (OCCLUSION_LEVELS - 1)) >= 1, "too many occlusion levels");
+
+// Normalized device depth, level n is (OCCLUSION_WIDTH >> n) x (OCCLUSION_HEIGHT >> n)
+std::vector<float> occlusionLevels[OCCLUSION_LEVELS];
+
+
+// Draws a triangle in occlusion buffer coordinates, keeping the nearest
+// depth. Coverage is sampled at texel centres; the depth written is the
+// farthest the plane reaches within the texel, so occluders never come out
+// nearer than they are.
+void rasterizeOccluderTriangle(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2) {
+   float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+   if (area == 0.0f) return;
+   if (area < 0.0f) {
+       std::swap(v1, v2);
+       area = -area;
+   }
+
+
+   int minX = std::max(0, (int)std::floor(std::min({ v0.x, v1.x, v2.x })));
+   int maxX = std::min(OCCLUSION_WIDTH - 1, (int)std::ceil(std::max({ v0.x, v1.x, v2.x })));
+   int minY = std::max(0, (int)std::floor(std::min({ v0.y, v1.y, v2.y })));
+   int maxY = std::min(OCCLUSION_HEIGHT - 1, (int)std::ceil(std::max({ v0.y, v1.y, v2.y })));
+   if (minX > maxX || minY > maxY) return;
+   minX &= ~3;
+
+
+   // Edge functions and depth as a * x + b * y + c, positive inside
+   const glm::vec3* corners[3] = { &v0, &v1, &v2 };
+   float ea[3], eb[3], ec[3];
+   for (int i = 0; i < 3; i++) {
+       const glm::vec3& a = *corners[i];
+       const glm::vec3& b = *corners[(i + 1) % 3];
+       ea[i] = a.y - b.y;
+       eb[i] = b.x - a.x;
+       ec[i] = -(ea[i] * a.x + eb[i] * a.y);
+   }
+   float za = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+   float zb = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+   float zc = v0.z - za * v0.x - zb * v0.y + 0.5f * (std::fabs(za) + std::fabs(zb));
+
+
+   std::vector<float>& depth = occlusionLevels[0];
+   for (int y = minY; y <= maxY; y++) {
+       float py = y + 0.5f;
+       float* row = &depth[y * OCCLUSION_WIDTH];
+#ifdef __SSE__
+       __m128 px = _mm_add_ps(_mm_set1_ps(minX + 0.5f), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+       __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(ea[0]), px), _mm_set1_ps(eb[0] * py + ec[0]));
+       __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(ea[1]), px), _mm_set1_ps(eb[1] * py + ec[1]));
+       __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(ea[2]), px), _mm_set1_ps(eb[2] * py + ec[2]));
+       __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(za), px), _mm_set1_ps(zb * py + zc));
+       __m128 step0 = _mm_set1_ps(ea[0] * 4), step1 = _mm_set1_ps(ea[1] * 4), step2 = _mm_set1_ps(ea[2] * 4);
+       __m128 stepZ = _mm_set1_ps(za * 4);
+       for (int x = minX; x <= maxX; x += 4) {
+           __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, _mm_setzero_ps()),
+                                      _mm_and_ps(_mm_cmpge_ps(e1, _mm_setzero_ps()), _mm_cmpge_ps(e2, _mm_setzero_ps())));
+           __m128 old = _mm_loadu_ps(row + x);
+           __m128 nearer = _mm_min_ps(old, z);
+           _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+           e0 = _mm_add_ps(e0, step0);
+           e1 = _mm_add_ps(e1, step1);
+           e2 = _mm_add_ps(e2, step2);
+           z = _mm_add_ps(z, stepZ);
+       }
+#else
+       for (int x = minX; x <= maxX; x++) {
+           float px = x + 0.5f;
+           if (ea[0] * px + eb[0] * py + ec[0] < 0.0f) continue;
+           if (ea[1] * px + eb[1] * py + ec[1] < 0.0f) continue;
+           if (ea[2] * px + eb[2] * py + ec[2] < 0.0f) continue;
+           row[x] = std::min(row[x], za * px + zb * py + zc);
+       }
+#endif
+   }
+}
+
+
+// Draws a convex polygon given in clip space, clipped against the near plane
+void rasterizeOccluder(const glm::vec4* corners, int count) {
+   glm::vec4 clipped[8];
+   int clippedCount = 0;
+   for (int i = 0; i < count; i++) {
+       const glm::vec4& a = corners[i];
+       const glm::vec4& b = corners[(i + 1) % count];
+       float da = a.z + a.w;
+       float db = b.z + b.w;
+       if (da >= 0.0f) clipped[clippedCount++] = a;
+       if ((da >= 0.0f) != (db >= 0.0f)) clipped[clippedCount++] = a + (b - a) * (da / (da - db));
+   }
+   if (clippedCount < 3) return;
+
+
+   glm::vec3 screen[8];
+   for (int i = 0; i < clippedCount; i++) {
+       glm::vec3 ndc = glm::vec3(clipped[i]) / clipped[i].w;
+       screen[i] = glm::vec3((ndc.x * 0.5f + 0.5f) * OCCLUSION_WIDTH, (ndc.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT, ndc.z);
+   }
+   for (int i = 1; i + 1 < clippedCount; i++) {
+       rasterizeOccluderTriangle(screen[0], screen[i], screen[i + 1]);
+   }
+}
+
+
+// Draws the faces of a box that face the camera
+void rasterizeOccluderBox(const glm::mat4& viewProjection, glm::vec3 boxMin, glm::vec3 boxMax) {
+   glm::vec4 corners[8];
+   for (int i = 0; i < 8; i++) {
+       glm::vec3 corner(i & 1 ? boxMax.x : boxMin.x, i & 2 ? boxMax.y : boxMin.y, i & 4 ? boxMax.z : boxMin.z);
+       corners[i] = viewProjection * glm::vec4(corner, 1.0f);
+   }
+
+
+   // Corner indices of the -X, +X, -Y, +Y, -Z and +Z faces, in winding order
+   static const int faces[6][4] = {
+       { 0, 4, 6, 2 }, { 1, 3, 7, 5 }, { 0, 1, 5, 4 }, { 2, 6, 7, 3 }, { 0, 2, 3, 1 }, { 4, 5, 7, 6 }
+   };
+   for (int f = 0; f < 6; f++) {
+       int axis = f / 2;
+       bool facing = f % 2 == 0 ? cameraPos[axis] < boxMin[axis] : cameraPos[axis] > boxMax[axis];
+       if (!facing) continue;
+       glm::vec4 face[4] = { corners[faces[f][0]], corners[faces[f][1]], corners[faces[f][2]], corners[faces[f][3]] };
+       rasterizeOccluder(face, 4);
+   }
+}
+
+
+// Clears the occlusion buffer, draws the solid layers of the given chunks and
+// builds the pyramid
+void renderOccluders(const glm::mat4& viewProjection, const std::vector<const Chunk*>& chunks) {
+   for (int level = 0; level < OCCLUSION_LEVELS; level++) {
+       occlusionLevels[level].assign((OCCLUSION_WIDTH >> level) * (OCCLUSION_HEIGHT >> level), 1.0f);
+   }
+
+
+   for (const Chunk* chunk : chunks) {
+       uint64_t layers = chunk->mesh.solidLayers;
+       while (layers) {
+           int y0 = __builtin_ctzll(layers);
+           int y1 = y0;
+           while (y1 < WORLD_HEIGHT && (layers >> y1 & 1)) y1++;
+           layers &= y1 < 64 ? ~0ULL << y1 : 0;
+
+
+           glm::vec3 boxMin(chunk->cx * CHUNK_SIZE, y0, chunk->cz * CHUNK_SIZE);
+           rasterizeOccluderBox(viewProjection, boxMin, boxMin + glm::vec3(CHUNK_SIZE, y1 - y0, CHUNK_SIZE));
+       }
+   }
+
+
+   for (int level = 1; level < OCCLUSION_LEVELS; level++) {
+       const std::vector<float>& finer = occlusionLevels[level - 1];
+       std::vector<float>& coarser = occlusionLevels[level];
+       int finerWidth = OCCLUSION_WIDTH >> (level - 1);
+       int width = OCCLUSION_WIDTH >> level;
+       int height = OCCLUSION_HEIGHT >> level;
+       for (int y = 0; y < height; y++) {
+           for (int x = 0; x < width; x++) {
+               const float* texels = &finer[2 * y * finerWidth + 2 * x];
+               coarser[y * width + x] = std::max(std::max(texels[0], texels[1]),
+                                                 std::max(texels[finerWidth], texels[finerWidth + 1]));
+           }
+       }
+   }
+}
+
+
+// True when a box is certainly hidden behind the occluders drawn this frame.
+// The screen rectangle is widened by a texel to cover occluder edges, which
+// were sampled at texel centres, and tested on the level where it spans at
+// most two texels each way.
+bool isOccluded(const glm::mat4& viewProjection, glm::vec3 boxMin, glm::vec3 boxMax) {
+   float minX = OCCLUSION_WIDTH, maxX = 0.0f, minY = OCCLUSION_HEIGHT, maxY = 0.0f, nearest = 1.0f;
+   for (int i = 0; i < 8; i++) {
+       glm::vec3 corner(i & 1 ? boxMax.x : boxMin.x, i & 2 ? boxMax.y : boxMin.y, i & 4 ? boxMax.z : boxMin.z);
+       glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+       if (clip.z < -clip.w) return false;  // reaches past the near plane
+       glm::vec3 ndc = glm::vec3(clip) / clip.w;
+       minX = std::min(minX, (ndc.x * 0.5f + 0.5f) * OCCLUSION_WIDTH);
+       maxX = std::max(maxX, (ndc.x * 0.5f + 0.5f) * OCCLUSION_WIDTH);
+       minY = std::min(minY, (ndc.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT);
+       maxY = std::max(maxY, (ndc.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT);
+       nearest = std::min(nearest, ndc.z);
+   }
+
+
+   int x0 = std::max(0, (int)std::floor(minX) - 1);
+   int x1 = std::min(OCCLUSION_WIDTH - 1, (int)std::floor(maxX) + 1);
+   int y0 = std::max(0, (int)std::floor(minY) - 1);
+   int y1 = std::min(OCCLUSION_HEIGHT - 1, (int)std::floor(maxY) + 1);
+   if (x0 > x1 || y0 > y1) return false;
+
+
+   int level = 0;
+   while (level + 1 < OCCLUSION_LEVELS && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)) level++;
+   const std::vector<float>& depth = occlusionLevels[level];
+   int width = OCCLUSION_WIDTH >> level;
+   for (int y = y0 >> level; y <= y1 >> level; y++) {
+       for (int x = x0 >> level; x <= x1 >> level; x++) {
+           if (depth[y * width + x] >= nearest) return false;
+       }
+   }
+   return true;
+}
+
+
+// Cave culling. Starting from the camera's section, walks into neighbouring
+// sections through the faces their flood fills connected to the face it
+// entered by, and drops the chunks none of whose sections were reached. Leaving
+// the top of the world reaches the top section of every column from there,
+// and leaving the bottom every bottom section.
+void cullSealedChunks() {
+   chunksSealedLastFrame = 0;
+   glm::ivec3 eye(glm::floor(cameraPos));
+   bool inWorld = eye.y >= 0 && eye.y < WORLD_HEIGHT;
+   Chunk* start = inWorld ? world.find(eye.x >> CHUNK_SHIFT, eye.z >> CHUNK_SHIFT) : nullptr;
+   if (inWorld) {
+       BlockType eyeBlock = getWorldBlock(eye.x, eye.y, eye.z);
+       if (!start || (eyeBlock != AIR && eyeBlock != GLASS)) return;
+   }
+
+
+   // The camera's section may only be left through the faces of the pocket
+   // the camera is in. Filled again when the camera moves to another block
+   // or the chunk is edited.
+   static std::shared_ptr<const ChunkData> pocketData;
+   static glm::ivec3 pocketEye;
+   static int pocketFaces = 0;
+   if (start && (start->snapshot() != pocketData || eye != pocketEye)) {
+       pocketData = start->snapshot();
+       pocketEye = eye;
+       const ChunkSection& section = pocketData->sections[eye.y / SECTION_SIZE];
+       BlockType blocks[SECTION_VOLUME];
+       for (int i = 0; i < SECTION_VOLUME; i++) blocks[i] = section.get(i);
+       bool visited[SECTION_VOLUME] = {};
+       pocketFaces = fillPocket(blocks, blockIndex(eye.x & (CHUNK_SIZE - 1), eye.y % SECTION_SIZE, eye.z & (CHUNK_SIZE - 1)), visited);
+   }
+
+
+   // Faces each section has been entered by. The camera's own section uses
+   // entry 6 and leaves through pocketFaces.
+   struct CaveStep {
+       const Chunk* chunk;
+       int section;
+       int entry;
+   };
+   static std::unordered_map<const Chunk*, std::array<uint8_t, SECTIONS_PER_CHUNK>> entered;
+   static std::vector<CaveStep> queue;
+   entered.clear();
+   queue.clear();
+
+
+   auto enter = [](const Chunk* chunk, int section, int entry) {
+       uint8_t& faces = entered[chunk][section];
+       if (faces & 1 << entry) return;
+       faces |= 1 << entry;
+       queue.push_back({ chunk, section, entry });
+   };
+   // The open space above or below the world touches that end of every column
+   bool reachedTop = false, reachedBottom = false;
+   auto enterFromOutside = [&enter](Face side, bool& reached) {
+       if (reached) return;
+       reached = true;
+       for (const ChunkMap::Slot& slot : world.slots) {
+           if (slot.chunk) enter(slot.chunk, side == FACE_TOP ? SECTIONS_PER_CHUNK - 1 : 0, side);
+       }
+   };
+   if (start) enter(start, eye.y / SECTION_SIZE, 6);
+   else enterFromOutside(eye.y < 0 ? FACE_BOTTOM : FACE_TOP, eye.y < 0 ? reachedBottom : reachedTop);
+
+
+   for (size_t next = 0; next < queue.size(); next++) {
+       CaveStep step = queue[next];
+       uint64_t visibility = step.chunk->mesh.sectionVisibility[step.section];
+       for (int exit = 0; exit < 6; exit++) {
+           if (step.entry == 6 ? !(pocketFaces >> exit & 1) : !(visibility >> (step.entry * 6 + exit) & 1)) continue;
+
+
+           if (exit == FACE_BOTTOM || exit == FACE_TOP) {
+               int section = step.section + faceNormals[exit].y;
+               if (section >= 0 && section < SECTIONS_PER_CHUNK) {
+                   enter(step.chunk, section, exit ^ 1);
+               } else {
+                   enterFromOutside((Face)exit, exit == FACE_TOP ? reachedTop : reachedBottom);
+               }
+               continue;
+           }
+
+
+           const Chunk* neighbor = world.find(step.chunk->cx + faceNormals[exit].x, step.chunk->cz + faceNormals[exit].z);
+           if (neighbor) enter(neighbor, step.section, exit ^ 1);
+       }
+   }
+
+
+   size_t kept = 0;
+   for (const Chunk* chunk : visibleChunks) {
+       if (entered.count(chunk)) visibleChunks[kept++] = chunk;
+   }
+   chunksSealedLastFrame = visibleChunks.size() - kept;
+   visibleChunks.resize(kept);
+}
+
+
+// Fills visibleChunks with the chunks whose column bounds touch the frustum.
+// A box is outside when its corner furthest along a plane's normal is still
+// behind it; that corner's distance is the sum of the larger of the min and
+// max terms per axis, so four chunks are tested per plane at once.
+void cullChunks(const glm::mat4& viewProjection) {
+   static std::vector<const Chunk*> candidates;
+   static std::vector<float> minX, minZ;
+   candidates.clear();
+   minX.clear();
+   minZ.clear();
+   for (const ChunkMap::Slot& slot : world.slots) {
+       if (!slot.chunk) continue;
+       const ChunkMesh& mesh = slot.chunk->mesh;
+       if (mesh.opaqueVertexCount + mesh.transparentVertexCount == 0 && mesh.solidLayers == 0) continue;
+       candidates.push_back(slot.chunk);
+       minX.push_back((float)(slot.chunk->cx * CHUNK_SIZE));
+       minZ.push_back((float)(slot.chunk->cz * CHUNK_SIZE));
+   }
+   size_t count = candidates.size();
+   while (minX.size() % 4 != 0) {
+       minX.push_back(0.0f);
+       minZ.push_back(0.0f);
+   }
+
+
+   Frustum frustum = extractFrustum(viewProjection);
+   visibleChunks.clear();
+   for (size_t i = 0; i < count; i += 4) {
+       int inside = 0xF;
+#ifdef __SSE__
+       __m128 x0 = _mm_loadu_ps(&minX[i]);
+       __m128 z0 = _mm_loadu_ps(&minZ[i]);
+       __m128 x1 = _mm_add_ps(x0, _mm_set1_ps((float)CHUNK_SIZE));
+       __m128 z1 = _mm_add_ps(z0, _mm_set1_ps((float)CHUNK_SIZE));
+       for (const glm::vec4& plane : frustum.planes) {
+           __m128 a = _mm_set1_ps(plane.x);
+           __m128 c = _mm_set1_ps(plane.z);
+           __m128 distance = _mm_add_ps(_mm_max_ps(_mm_mul_ps(a, x0), _mm_mul_ps(a, x1)),
+                                        _mm_max_ps(_mm_mul_ps(c, z0), _mm_mul_ps(c, z1)));
+           distance = _mm_add_ps(distance, _mm_set1_ps(std::max(0.0f, plane.y * WORLD_HEIGHT) + plane.w));
+           inside &= _mm_movemask_ps(_mm_cmpge_ps(distance, _mm_setzero_ps()));
+       }
+#else
+       for (int lane = 0; lane < 4; lane++) {
+           for (const glm::vec4& plane : frustum.planes) {
+               float distance = std::max(plane.x * minX[i + lane], plane.x * (minX[i + lane] + CHUNK_SIZE))
+                              + std::max(plane.z * minZ[i + lane], plane.z * (minZ[i + lane] + CHUNK_SIZE))
+                              + std::max(0.0f, plane.y * WORLD_HEIGHT) + plane.w;
+               if (distance < 0.0f) inside &= ~(1 << lane);
+           }
+       }
+#endif
+       for (int lane = 0; lane < 4 && i + lane < count; lane++) {
+           if (inside & (1 << lane)) visibleChunks.push_back(candidates[i + lane]);
+       }
+   }
+   chunksCulledLastFrame = count - visibleChunks.size();
+   cullSealedChunks();
+
+
+   // Chunks buried in solid neighbours still occlude, but have nothing to draw.
+   // From inside a solid block everything would be hidden, so nothing is tested.
+   auto begin = std::chrono::steady_clock::now();
+   glm::ivec3 eye(glm::floor(cameraPos));
+   BlockType eyeBlock = getWorldBlock(eye.x, eye.y, eye.z);
+   bool testOcclusion = occlusionCulling && (eyeBlock == AIR || eyeBlock == GLASS);
+   if (testOcclusion) renderOccluders(viewProjection, visibleChunks);
+   size_t kept = 0;
+   chunksOccludedLastFrame = 0;
+   for (const Chunk* chunk : visibleChunks) {
+       const ChunkMesh& mesh = chunk->mesh;
+       if (mesh.opaqueVertexCount + mesh.transparentVertexCount == 0) continue;
+       glm::vec3 boxMin(chunk->cx * CHUNK_SIZE, mesh.minY, chunk->cz * CHUNK_SIZE);
+       glm::vec3 boxMax(boxMin.x + CHUNK_SIZE, mesh.maxY, boxMin.z + CHUNK_SIZE);
+       if (testOcclusion && isOccluded(viewProjection, boxMin, boxMax)) {
+           chunksOccludedLastFrame++;
+           continue;
+       }
+       visibleChunks[kept++] = chunk;
+   }
+   visibleChunks.resize(kept);
+   std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+   occlusionMillisLastFrame = elapsed.count();
+}
+
+
+void initCrosshair() {
+   float size = 0.02f;
+   float thickness = 0.005f;
+   float aspectRatio = (float)WIDTH / (float)HEIGHT;
+   float verticalSize = size * aspectRatio;
+  
+   std::array<float, 32> vertices = {
+       -size, -thickness/2, size, -thickness/2,
+       size, thickness/2, -size, thickness/2,
+       -thickness/2, -verticalSize, thickness/2, -verticalSize,
+       thickness/2, verticalSize, -thickness/2, verticalSize
+   };
+  
+   glGenVertexArrays(1, &crosshairVAO);
+   glGenBuffers(1, &crosshairVBO);
+  
+   glBindVertexArray(crosshairVAO);
+   glBindBuffer(GL_ARRAY_BUFFER, crosshairVBO);
+   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices.data(), GL_STATIC_DRAW);
+  
+   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
    glEnableVertexAttribArray(0);
-   glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-   glEnableVertexAttribArray(1);
+  
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+   glBindVertexArray(0);
+  
+   const char* crosshairVertexShaderSource = "#version 330 core\n"
+       "layout (location = 0) in vec2 aPos;\n"
+       "void main() {\n"
+       "   gl_Position = vec4(aPos, 0.0, 1.0);\n"
+       "}\0";
+
+
+   const char* crosshairFragmentShaderSource = "#version 330 core\n"
+       "out vec4 FragColor;\n"
+       "void main() {\n"
+       "   FragColor = vec4(1.0, 1.0, 1.0, 0.8);\n"
+       "}\0";
+
+
+   unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
+   glShaderSource(vertexShader, 1, &crosshairVertexShaderSource, NULL);
+   glCompileShader(vertexShader);
+  
+   unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+   glShaderSource(fragmentShader, 1, &crosshairFragmentShaderSource, NULL);
+   glCompileShader(fragmentShader);
+  
+   crosshairShader = glCreateProgram();
+   glAttachShader(crosshairShader, vertexShader);
+   glAttachShader(crosshairShader, fragmentShader);
+   glLinkProgram(crosshairShader);
+  
+   glDeleteShader(vertexShader);
+   glDeleteShader(fragmentShader);
+}
+
+
+void renderCrosshair() {
+   setDepthTest(false);
+   setBlend(false);
+   setWireframe(false);
+  
+   useProgram(crosshairShader);
+   bindVertexArray(crosshairVAO);
+  
+   callGL(glDrawArrays, GL_TRIANGLE_FAN, 0, 4);
+   callGL(glDrawArrays, GL_TRIANGLE_FAN, 4, 4);
+  
+   setDepthTest(true);
+}
+
+
+// Region files: the world is saved under worldDirectory as one file per
+// REGION_SIZE x REGION_SIZE chunks. A file starts with a fixed header holding
+// an offset table with one entry per chunk, followed by chunk payloads. Files
+// are read through mmap, so loading a chunk faults in the header page and its
+// payload and nothing else. Only chunks edited by the player are written;
+// everything else is regenerated on load.
+const int REGION_SHIFT = 5;
+const int REGION_SIZE = 1 << REGION_SHIFT;
+const uint32_t REGION_MAGIC = 0x4752434d;  // "MCRG"
+const uint32_t REGION_VERSION = 3;
+std::string worldDirectory = "world";
+
+
+struct RegionEntry {
+   uint32_t offset;    // 0 when the chunk is not stored
+   uint32_t length;
+   uint32_t capacity;  // bytes reserved at offset, kept when a payload shrinks
+};
+
+
+struct RegionHeader {
+   uint32_t magic;
+   uint32_t version;
+   RegionEntry entries[REGION_SIZE * REGION_SIZE];
+};
+
+
+struct RegionFile {
+   int fd = -1;
+   const uint8_t* map = nullptr;  // mapped lazily, dropped when the file grows
+   size_t mapSize = 0;
+   size_t fileSize = 0;
+};
+std::unordered_map<uint64_t, RegionFile*> regionFiles;
+
+
+RegionFile* openRegion(int rx, int rz, bool create) {
+   uint64_t key = chunkKey(rx, rz);
+   auto it = regionFiles.find(key);
+   if (it != regionFiles.end()) return it->second;
+
+
+   std::string path = worldDirectory + "/r." + std::to_string(rx) + "." + std::to_string(rz) + ".region";
+   if (create) mkdir(worldDirectory.c_str(), 0755);
+   int fd = open(path.c_str(), create ? O_RDWR | O_CREAT : O_RDWR, 0644);
+   if (fd < 0) {
+       if (create) std::cerr << "Failed to open region file " << path << std::endl;
+       return nullptr;
+   }
+
+
+   struct stat st;
+   fstat(fd, &st);
+   RegionFile* region = new RegionFile();
+   region->fd = fd;
+   region->fileSize = st.st_size;
+
+
+   // Files from an older format can't be read back, so start them over
+   // rather than appending chunks that would never load. This has to happen
+   // on every open, since reads open and cache the file before any save.
+   if (region->fileSize >= sizeof(RegionHeader)) {
+       uint32_t magicVersion[2];
+       if (pread(fd, magicVersion, sizeof(magicVersion), 0) != (ssize_t)sizeof(magicVersion) ||
+           magicVersion[0] != REGION_MAGIC || magicVersion[1] != REGION_VERSION) {
+           std::cerr << "Replacing outdated region file " << path << std::endl;
+           if (ftruncate(fd, 0) != 0) std::cerr << "Failed to truncate " << path << std::endl;
+           region->fileSize = 0;
+       }
+   }
+   if (region->fileSize < sizeof(RegionHeader)) {
+       RegionHeader header = {};
+       header.magic = REGION_MAGIC;
+       header.version = REGION_VERSION;
+       if (pwrite(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+           std::cerr << "Failed to write region header " << path << std::endl;
+       }
+       region->fileSize = sizeof(RegionHeader);
+   }
+
+
+   regionFiles[key] = region;
+   return region;
+}
+
+
+const uint8_t* mapRegion(RegionFile* region) {
+   if (!region->map) {
+       void* map = mmap(nullptr, region->fileSize, PROT_READ, MAP_SHARED, region->fd, 0);
+       if (map == MAP_FAILED) return nullptr;
+       region->map = (const uint8_t*)map;
+       region->mapSize = region->fileSize;
+   }
+   return region->map;
+}
+
+
+void closeRegions() {
+   for (auto& entry : regionFiles) {
+       RegionFile* region = entry.second;
+       if (region->map) munmap((void*)region->map, region->mapSize);
+       close(region->fd);
+       delete region;
+   }
+   regionFiles.clear();
+}
+
+
+// Chunk codec, used for every chunk payload. Each section is stored as a
+// single block type, as runs over its linearised palette indices (an index
+// byte and a varint length per run), or as its packed index words when runs
+// would come out larger. The payload then goes through a small LZ pass if
+// that shrinks it further.
+enum SectionEncoding : uint8_t { SECTION_UNIFORM, SECTION_RUNS, SECTION_PACKED };
+enum PayloadEncoding : uint8_t { PAYLOAD_RAW, PAYLOAD_LZ };
+
+
+void writeVarint(std::vector<uint8_t>& out, uint32_t value) {
+   while (value >= 0x80) {
+       out.push_back(value | 0x80);
+       value >>= 7;
+   }
+   out.push_back(value);
+}
+
+
+bool readVarint(const uint8_t*& data, const uint8_t* end, uint32_t& value) {
+   value = 0;
+   for (int shift = 0; shift < 32; shift += 7) {
+       if (data == end) return false;
+       uint8_t byte = *data++;
+       value |= (uint32_t)(byte & 0x7f) << shift;
+       if (!(byte & 0x80)) return true;
+   }
+   return false;
+}
+
+
+void encodeSection(const ChunkSection& section, std::vector<uint8_t>& out) {
+   if (section.isUniform()) {
+       out.push_back(SECTION_UNIFORM);
+       out.push_back(section.palette[0]);
+       return;
+   }
+
+
+   size_t start = out.size();
+   size_t packedSize = 3 + section.palette.size() + section.data.size() * sizeof(uint64_t);
+   out.push_back(SECTION_RUNS);
+   out.push_back(section.palette.size() - 1);
+   out.insert(out.end(), section.palette.begin(), section.palette.end());
+
+
+   int bits = 1 << section.bitsLog2;
+   int perWord = 64 >> section.bitsLog2;
+   uint64_t mask = (1ULL << bits) - 1;
+   uint8_t runId = section.data[0] & mask;
+   uint32_t runLength = 0;
+   for (size_t w = 0; w < section.data.size() && out.size() - start <= packedSize; w++) {
+       uint64_t word = section.data[w];
+       // A word of identical indices extends or starts a run in one step
+       if (word == (word & mask) * (~0ULL / mask)) {
+           uint8_t id = word & mask;
+           if (id != runId) {
+               out.push_back(runId);
+               writeVarint(out, runLength);
+               runId = id;
+               runLength = 0;
+           }
+           runLength += perWord;
+           continue;
+       }
+       for (int i = 0; i < perWord; i++) {
+           uint8_t id = word & mask;
+           word >>= bits;
+           if (id == runId) {
+               runLength++;
+               continue;
+           }
+           out.push_back(runId);
+           writeVarint(out, runLength);
+           runId = id;
+           runLength = 1;
+       }
+   }
+   out.push_back(runId);
+   writeVarint(out, runLength);
+
+
+   if (out.size() - start > packedSize) {
+       out.resize(start);
+       out.push_back(SECTION_PACKED);
+       out.push_back(section.palette.size() - 1);
+       out.insert(out.end(), section.palette.begin(), section.palette.end());
+       out.push_back(section.bitsLog2);
+       const uint8_t* words = (const uint8_t*)section.data.data();
+       out.insert(out.end(), words, words + section.data.size() * sizeof(uint64_t));
+   }
+}
+
+
+bool decodeSection(const uint8_t*& data, const uint8_t* end, ChunkSection& section) {
+   if (end - data < 2) return false;
+   uint8_t encoding = *data++;
+   if (encoding == SECTION_UNIFORM) {
+       if (*data >= BLOCK_TYPE_COUNT) return false;
+       section.palette.assign(1, (BlockType)*data++);
+       section.bitsLog2 = 0;
+       std::vector<uint64_t>().swap(section.data);
+       return true;
+   }
+
+
+   size_t paletteSize = *data++ + 1;
+   if ((size_t)(end - data) < paletteSize) return false;
+   section.palette.assign((const BlockType*)data, (const BlockType*)data + paletteSize);
+   data += paletteSize;
+   for (BlockType type : section.palette) {
+       if (type >= BLOCK_TYPE_COUNT) return false;
+   }
+
+
+   if (encoding == SECTION_PACKED) {
+       if (data == end) return false;
+       int bitsLog2 = *data++;
+       if (bitsLog2 > 3 || (1u << (1 << bitsLog2)) < paletteSize) return false;
+       size_t words = SECTION_VOLUME >> (6 - bitsLog2);
+       if ((size_t)(end - data) < words * sizeof(uint64_t)) return false;
+       section.bitsLog2 = bitsLog2;
+       section.data.resize(words);
+       memcpy(section.data.data(), data, words * sizeof(uint64_t));
+       data += words * sizeof(uint64_t);
+       return true;
+   }
+   if (encoding != SECTION_RUNS) return false;
+
+
+   section.bitsLog2 = 0;
+   while ((1u << (1 << section.bitsLog2)) < paletteSize) section.bitsLog2++;
+   int bits = 1 << section.bitsLog2;
+   int perWordLog2 = 6 - section.bitsLog2;
+   int perWord = 1 << perWordLog2;
+   uint64_t mask = (1ULL << bits) - 1;
+   section.data.assign(SECTION_VOLUME >> perWordLog2, 0);
+
+
+   int i = 0;
+   while (i < SECTION_VOLUME) {
+       if (data == end) return false;
+       uint64_t id = *data++;
+       uint32_t length;
+       if (id >= paletteSize || !readVarint(data, end, length)) return false;
+       if (length == 0 || length > (uint32_t)(SECTION_VOLUME - i)) return false;
+
+
+       // Partial words entry by entry, whole words in one store
+       int runEnd = i + length;
+       for (; i < runEnd && (i & (perWord - 1)); i++) {
+           section.data[i >> perWordLog2] |= id << ((i & (perWord - 1)) << section.bitsLog2);
+       }
+       uint64_t pattern = id * (~0ULL / mask);
+       for (; i + perWord <= runEnd; i += perWord) section.data[i >> perWordLog2] = pattern;
+       for (; i < runEnd; i++) {
+           section.data[i >> perWordLog2] |= id << ((i & (perWord - 1)) << section.bitsLog2);
+       }
+   }
+   return true;
+}
+
+
+// LZ stage: LZ4-style sequences of a token (literal count and match length
+// minus LZ_MIN_MATCH in its two nibbles), the literals and a 16-bit match
+// offset. Nibbles of 15 continue in extra length bytes. The final sequence
+// has literals only.
+const int LZ_MIN_MATCH = 4;
+const int LZ_HASH_BITS = 12;
+
+
+void lzWriteLength(std::vector<uint8_t>& out, size_t length) {
+   for (; length >= 255; length -= 255) out.push_back(255);
+   out.push_back(length);
+}
+
+
+bool lzReadLength(const uint8_t*& data, const uint8_t* end, size_t& length) {
+   uint8_t byte;
+   do {
+       if (data == end) return false;
+       byte = *data++;
+       length += byte;
+   } while (byte == 255);
+   return true;
+}
+
+
+void lzEmit(std::vector<uint8_t>& out, const uint8_t* literals, size_t literalCount, size_t match, size_t offset) {
+   size_t matchCode = match ? match - LZ_MIN_MATCH : 0;
+   out.push_back((std::min<size_t>(literalCount, 15) << 4) | std::min<size_t>(matchCode, 15));
+   if (literalCount >= 15) lzWriteLength(out, literalCount - 15);
+   out.insert(out.end(), literals, literals + literalCount);
+   if (!match) return;
+   out.push_back(offset & 0xff);
+   out.push_back(offset >> 8);
+   if (matchCode >= 15) lzWriteLength(out, matchCode - 15);
+}
+
+
+void lzCompress(const uint8_t* in, size_t size, std::vector<uint8_t>& out) {
+   uint32_t table[1 << LZ_HASH_BITS];
+   std::fill(table, table + (1 << LZ_HASH_BITS), UINT32_MAX);
+
+
+   size_t anchor = 0, i = 0;
+   while (i + LZ_MIN_MATCH <= size) {
+       uint32_t sequence;
+       memcpy(&sequence, in + i, sizeof(sequence));
+       uint32_t hash = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+       uint32_t candidate = table[hash];
+       table[hash] = i;
+       if (candidate == UINT32_MAX || i - candidate > 0xffff || memcmp(in + candidate, in + i, LZ_MIN_MATCH) != 0) {
+           i++;
+           continue;
+       }
+
+
+       size_t match = LZ_MIN_MATCH;
+       while (i + match < size && in[candidate + match] == in[i + match]) match++;
+       lzEmit(out, in + anchor, i - anchor, match, i - candidate);
+       i += match;
+       anchor = i;
+   }
+   lzEmit(out, in + anchor, size - anchor, 0, 0);
+}
+
+
+bool lzDecompress(const uint8_t* data, size_t size, uint8_t* out, size_t outSize) {
+   const uint8_t* end = data + size;
+   size_t written = 0;
+   while (data < end) {
+       uint8_t token = *data++;
+       size_t literals = token >> 4;
+       if (literals == 15 && !lzReadLength(data, end, literals)) return false;
+       if ((size_t)(end - data) < literals || outSize - written < literals) return false;
+       memcpy(out + written, data, literals);
+       data += literals;
+       written += literals;
+       if (data == end) break;
+
+
+       if (end - data < 2) return false;
+       size_t offset = data[0] | data[1] << 8;
+       data += 2;
+       size_t match = token & 15;
+       if (match == 15 && !lzReadLength(data, end, match)) return false;
+       match += LZ_MIN_MATCH;
+       if (offset == 0 || offset > written || outSize - written < match) return false;
+       // Byte by byte since a match may overlap its own output
+       for (size_t k = 0; k < match; k++, written++) out[written] = out[written - offset];
+   }
+   return written == outSize;
+}
+
+
+// Payload: a PayloadEncoding byte, then the encoded sections, either as is or
+// LZ compressed behind their uncompressed size
+void encodeChunk(const ChunkData& chunk, std::vector<uint8_t>& out) {
+   std::vector<uint8_t> sections;
+   for (const ChunkSection& section : chunk.sections) encodeSection(section, sections);
+
+
+   out.clear();
+   out.push_back(PAYLOAD_LZ);
+   uint32_t sectionBytes = sections.size();
+   out.insert(out.end(), (const uint8_t*)&sectionBytes, (const uint8_t*)&sectionBytes + sizeof(sectionBytes));
+   lzCompress(sections.data(), sections.size(), out);
+   if (out.size() >= sections.size() + 1) {
+       out.clear();
+       out.push_back(PAYLOAD_RAW);
+       out.insert(out.end(), sections.begin(), sections.end());
+   }
+}
+
+
+bool decodeChunk(const uint8_t* data, size_t size, ChunkData& chunk) {
+   if (size < 1) return false;
+   std::vector<uint8_t> sections;
+   const uint8_t* end = data + size;
+   if (*data == PAYLOAD_LZ) {
+       uint32_t sectionBytes;
+       if (size < 1 + sizeof(sectionBytes)) return false;
+       memcpy(&sectionBytes, data + 1, sizeof(sectionBytes));
+       data += 1 + sizeof(sectionBytes);
+       // Every section takes at least two bytes and at most its packed size plus palette
+       if (sectionBytes < SECTIONS_PER_CHUNK * 2 || sectionBytes > SECTIONS_PER_CHUNK * (SECTION_VOLUME + 259)) return false;
+       sections.resize(sectionBytes);
+       if (!lzDecompress(data, end - data, sections.data(), sectionBytes)) return false;
+       data = sections.data();
+       end = data + sections.size();
+   } else if (*data == PAYLOAD_RAW) {
+       data++;
+   } else {
+       return false;
+   }
+
+
+   for (ChunkSection& section : chunk.sections) {
+       if (!decodeSection(data, end, section)) return false;
+   }
+   return data == end;
+}
+
+
+int regionEntryIndex(int cx, int cz) {
+   return (cz & (REGION_SIZE - 1)) * REGION_SIZE + (cx & (REGION_SIZE - 1));
+}
+
+
+// Returns false if the chunk has never been saved
+bool readChunkFromRegion(Chunk& chunk) {
+   RegionFile* region = openRegion(chunk.cx >> REGION_SHIFT, chunk.cz >> REGION_SHIFT, false);
+   if (!region) return false;
+   const uint8_t* map = mapRegion(region);
+   if (!map) return false;
+
+
+   const RegionHeader* header = (const RegionHeader*)map;
+   if (header->magic != REGION_MAGIC || header->version != REGION_VERSION) return false;
+   RegionEntry entry = header->entries[regionEntryIndex(chunk.cx, chunk.cz)];
+   if (entry.offset == 0 || (size_t)entry.offset + entry.length > region->mapSize) return false;
+
 
+   std::shared_ptr<ChunkData> data = std::make_shared<ChunkData>();
+   if (!decodeChunk(map + entry.offset, entry.length, *data)) {
+       std::cerr << "Corrupt chunk " << chunk.cx << ", " << chunk.cz << " in region file" << std::endl;
+       return false;
+   }
+   chunk.publish(data);
+   return true;
+}
 
-   glActiveTexture(GL_TEXTURE0);
-   glBindTexture(GL_TEXTURE_2D, textureID);
 
+// Rewrites the payload in place when it fits the chunk's reserved space,
+// otherwise appends it
+void writeChunkToRegion(int cx, int cz, const std::vector<uint8_t>& payload) {
+   RegionFile* region = openRegion(cx >> REGION_SHIFT, cz >> REGION_SHIFT, true);
+   if (!region) return;
 
-   glBindBuffer(GL_ARRAY_BUFFER, 0);
-   glBindVertexArray(VAO);
-  
-   if (type == GLASS) {
-       glEnable(GL_BLEND);
-       glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+   int index = regionEntryIndex(cx, cz);
+   off_t entryOffset = offsetof(RegionHeader, entries) + index * sizeof(RegionEntry);
+   RegionEntry entry = {};
+   if (pread(region->fd, &entry, sizeof(entry), entryOffset) != (ssize_t)sizeof(entry)) entry = {};
+
+
+   if (entry.offset == 0 || payload.size() > entry.capacity) {
+       // Leave headroom so a chunk whose size wobbles between saves settles
+       // into one slot instead of appending every time it grows
+       entry.offset = region->fileSize;
+       entry.capacity = payload.size() + payload.size() / 4;
+       region->fileSize += entry.capacity;
+       if (ftruncate(region->fd, region->fileSize) != 0) {
+           std::cerr << "Failed to grow region file for chunk " << cx << ", " << cz << std::endl;
+       }
+       if (region->map) {
+           munmap((void*)region->map, region->mapSize);
+           region->map = nullptr;
+       }
    }
-  
-   if (wireframeMode) {
-       glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-       glDisable(GL_TEXTURE_2D);
-       glDrawArrays(GL_TRIANGLES, 0, 36);
-       glEnable(GL_TEXTURE_2D);
-       glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-   } else {
-       glDrawArrays(GL_TRIANGLES, 0, 36);
+   entry.length = payload.size();
+
+
+   if (pwrite(region->fd, payload.data(), payload.size(), entry.offset) != (ssize_t)payload.size() ||
+       pwrite(region->fd, &entry, sizeof(entry), entryOffset) != (ssize_t)sizeof(entry)) {
+       std::cerr << "Failed to save chunk " << cx << ", " << cz << std::endl;
    }
-  
-   if (type == GLASS) {
-       glDisable(GL_BLEND);
+}
+
+
+void chunkIOThread() {
+   std::vector<ChunkWrite> writes;
+   std::vector<glm::ivec2> reads;
+   std::vector<ChunkRead> results;
+   std::vector<uint8_t> payload;
+
+
+   for (;;) {
+       bool checkpoint, stopping;
+       {
+           std::unique_lock<std::mutex> lock(chunkIO.mutex);
+           chunkIO.wake.wait(lock, [] {
+               return chunkIO.stopping || chunkIO.checkpointRequested ||
+                      !chunkIO.pendingWrites.empty() || !chunkIO.pendingReads.empty();
+           });
+           writes.clear();
+           for (auto& entry : chunkIO.pendingWrites) writes.push_back(std::move(entry.second));
+           chunkIO.pendingWrites.clear();
+           chunkIO.writesInFlight = writes.size();
+           reads.clear();
+           reads.swap(chunkIO.pendingReads);
+           checkpoint = chunkIO.checkpointRequested;
+           chunkIO.checkpointRequested = false;
+           stopping = chunkIO.stopping;
+       }
+
+
+       // Writes go first so a chunk saved and requested again in the same
+       // batch reads back its latest contents
+       for (const ChunkWrite& write : writes) {
+           encodeChunk(*write.data, payload);
+           writeChunkToRegion(write.cx, write.cz, payload);
+           chunkIO.chunksWritten++;
+           chunkIO.bytesWritten += payload.size();
+           chunkIO.writesInFlight--;
+       }
+
+
+       results.clear();
+       for (const glm::ivec2& c : reads) {
+           Chunk* chunk = new Chunk();
+           chunk->cx = c.x;
+           chunk->cz = c.y;
+           if (!readChunkFromRegion(*chunk)) {
+               delete chunk;
+               chunk = nullptr;
+           }
+           results.push_back(ChunkRead{c.x, c.y, chunk});
+       }
+       if (!results.empty()) {
+           std::lock_guard<std::mutex> lock(chunkIO.mutex);
+           chunkIO.completedReads.insert(chunkIO.completedReads.end(), results.begin(), results.end());
+       }
+
+
+       if (checkpoint || stopping) {
+           for (auto& entry : regionFiles) fsync(entry.second->fd);
+       }
+       if (stopping) break;
    }
-  
-   glBindVertexArray(0);
-  
-   glDeleteVertexArrays(1, &VAO);
-   glDeleteBuffers(1, &VBO);
 }
 
 
-void initCrosshair() {
-   float size = 0.02f;
-   float thickness = 0.005f;
-   float aspectRatio = (float)WIDTH / (float)HEIGHT;
-   float verticalSize = size * aspectRatio;
-  
-   std::array<float, 32> vertices = {
-       -size, -thickness/2, size, -thickness/2,
-       size, thickness/2, -size, thickness/2,
-       -thickness/2, -verticalSize, thickness/2, -verticalSize,
-       thickness/2, verticalSize, -thickness/2, verticalSize
+void startChunkIO() {
+   chunkIO.thread = std::thread(chunkIOThread);
+}
+
+
+// Flushes every queued write, checkpoints and joins the I/O thread
+void stopChunkIO() {
+   {
+       std::lock_guard<std::mutex> lock(chunkIO.mutex);
+       chunkIO.stopping = true;
+   }
+   chunkIO.wake.notify_one();
+   chunkIO.thread.join();
+
+
+   for (const ChunkRead& read : chunkIO.completedReads) delete read.chunk;
+   chunkIO.completedReads.clear();
+   closeRegions();
+}
+
+
+// Queues a snapshot of the chunk if it has unsaved edits
+void saveChunk(Chunk& chunk) {
+   if (!chunk.modified) return;
+   chunk.modified = false;
+
+
+   {
+       std::lock_guard<std::mutex> lock(chunkIO.mutex);
+       ChunkWrite& pending = chunkIO.pendingWrites[chunkKey(chunk.cx, chunk.cz)];
+       if (pending.data) chunkIO.writesCoalesced++;
+       pending = ChunkWrite{chunk.cx, chunk.cz, chunk.data};
+   }
+   chunkIO.wake.notify_one();
+}
+
+
+void requestChunkRead(int cx, int cz) {
+   {
+       std::lock_guard<std::mutex> lock(chunkIO.mutex);
+       chunkIO.pendingReads.push_back(glm::ivec2(cx, cz));
+   }
+   chunkIO.wake.notify_one();
+}
+
+
+void requestCheckpoint() {
+   {
+       std::lock_guard<std::mutex> lock(chunkIO.mutex);
+       chunkIO.checkpointRequested = true;
+   }
+   chunkIO.wake.notify_one();
+}
+
+
+void generateChunk(Chunk& chunk) {
+   std::shared_ptr<ChunkData> data = std::make_shared<ChunkData>();
+   // Flat platform of dirt
+   for (int x = 0; x < CHUNK_SIZE; x++) {
+       for (int z = 0; z < CHUNK_SIZE; z++) {
+           data->set(x, 0, z, DIRT);
+       }
+   }
+   data->collapseUniformSections();
+   chunk.publish(data);
+}
+
+
+// Adds a chunk read back from disk, or generates it if it was never saved
+Chunk* addChunk(int cx, int cz, Chunk* chunk) {
+   if (!chunk) {
+       chunk = new Chunk();
+       chunk->cx = cx;
+       chunk->cz = cz;
+       generateChunk(*chunk);
+   }
+   world.insert(cx, cz, chunk);
+
+
+   // Neighbours meshed before this chunk existed exposed their border faces
+   const int offsets[4][2] = { {-1, 0}, {1, 0}, {0, -1}, {0, 1} };
+   for (const auto& offset : offsets) {
+       Chunk* neighbor = world.find(cx + offset[0], cz + offset[1]);
+       if (neighbor) neighbor->mesh.dirty = true;
+   }
+   return chunk;
+}
+
+
+void unloadChunk(int cx, int cz) {
+   Chunk* chunk = world.remove(cx, cz);
+   if (!chunk) return;
+   saveChunk(*chunk);
+   destroyChunkMesh(chunk->mesh);
+   delete chunk;
+}
+
+
+double elapsedMs(std::chrono::steady_clock::time_point since) {
+   return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+
+// Re-queues missing chunks and unloads far ones whenever the camera crosses
+// into another chunk, sends the best queued chunks to the I/O thread, then
+// adds chunks it has read back until the frame budget is used.
+void updateStreaming(std::chrono::steady_clock::time_point frameStart) {
+   const size_t MAX_READS_IN_FLIGHT = 32;
+   static std::unordered_set<uint64_t> chunksInFlight;
+   static std::vector<ChunkRead> readyChunks;
+
+   static bool initialized = false;
+   static int centerX = 0, centerZ = 0;
+   int cx = (int)floor(cameraPos.x) >> CHUNK_SHIFT;
+   int cz = (int)floor(cameraPos.z) >> CHUNK_SHIFT;
+
+
+   if (!initialized || cx != centerX || cz != centerZ) {
+       initialized = true;
+       centerX = cx;
+       centerZ = cz;
+
+
+       // Keep one extra ring loaded so walking along a border does not thrash
+       int unloadDistance = renderDistance + 1;
+       std::vector<glm::ivec2> farChunks;
+       for (const ChunkMap::Slot& slot : world.slots) {
+           if (!slot.chunk) continue;
+           int dx = slot.chunk->cx - cx, dz = slot.chunk->cz - cz;
+           if (dx * dx + dz * dz > unloadDistance * unloadDistance) {
+               farChunks.push_back(glm::ivec2(slot.chunk->cx, slot.chunk->cz));
+           }
+       }
+       for (const glm::ivec2& c : farChunks) unloadChunk(c.x, c.y);
+
+
+       pendingChunks.clear();
+       for (int dx = -renderDistance; dx <= renderDistance; dx++) {
+           for (int dz = -renderDistance; dz <= renderDistance; dz++) {
+               if (dx * dx + dz * dz > renderDistance * renderDistance) continue;
+               if (world.find(cx + dx, cz + dz) || chunksInFlight.count(chunkKey(cx + dx, cz + dz))) continue;
+               pendingChunks.push_back(glm::ivec2(cx + dx, cz + dz));
+           }
+       }
+   }
+
+
+   {
+       std::lock_guard<std::mutex> lock(chunkIO.mutex);
+       readyChunks.insert(readyChunks.end(), chunkIO.completedReads.begin(), chunkIO.completedReads.end());
+       chunkIO.completedReads.clear();
+   }
+   size_t ready = 0;
+   for (; ready < readyChunks.size() && elapsedMs(frameStart) < STREAMING_BUDGET_MS; ready++) {
+       ChunkRead& read = readyChunks[ready];
+       chunksInFlight.erase(chunkKey(read.cx, read.cz));
+
+
+       // The camera may have moved on while the read was in flight
+       int dx = read.cx - cx, dz = read.cz - cz;
+       if (dx * dx + dz * dz > (renderDistance + 1) * (renderDistance + 1) || world.find(read.cx, read.cz)) {
+           delete read.chunk;
+           continue;
+       }
+       addChunk(read.cx, read.cz, read.chunk);
+   }
+   readyChunks.erase(readyChunks.begin(), readyChunks.begin() + ready);
+   if (pendingChunks.empty()) return;
+
+
+   // Chunks ahead of the camera count as up to half as far away, chunks
+   // behind as up to half again as far. Best candidate goes last.
+   glm::vec3 flatFront = glm::vec3(cameraFront.x, 0.0f, cameraFront.z);
+   if (glm::length(flatFront) > 0.0f) flatFront = glm::normalize(flatFront);
+   auto priority = [&](const glm::ivec2& c) {
+       glm::vec3 offset((c.x - cx) * CHUNK_SIZE, 0.0f, (c.y - cz) * CHUNK_SIZE);
+       float distance = glm::length(offset);
+       if (distance == 0.0f) return 0.0f;
+       return distance * (1.0f - 0.5f * glm::dot(offset / distance, flatFront));
    };
-  
-   glGenVertexArrays(1, &crosshairVAO);
-   glGenBuffers(1, &crosshairVBO);
-  
-   glBindVertexArray(crosshairVAO);
-   glBindBuffer(GL_ARRAY_BUFFER, crosshairVBO);
-   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices.data(), GL_STATIC_DRAW);
-  
-   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-   glEnableVertexAttribArray(0);
-  
-   glBindBuffer(GL_ARRAY_BUFFER, 0);
-   glBindVertexArray(0);
-  
-   const char* crosshairVertexShaderSource = "#version 330 core\n"
-       "layout (location = 0) in vec2 aPos;\n"
-       "void main() {\n"
-       "   gl_Position = vec4(aPos, 0.0, 1.0);\n"
-       "}\0";
+   std::sort(pendingChunks.begin(), pendingChunks.end(), [&](const glm::ivec2& a, const glm::ivec2& b) {
+       return priority(a) > priority(b);
+   });
 
 
-   const char* crosshairFragmentShaderSource = "#version 330 core\n"
-       "out vec4 FragColor;\n"
-       "void main() {\n"
-       "   FragColor = vec4(1.0, 1.0, 1.0, 0.8);\n"
-       "}\0";
+   while (!pendingChunks.empty() && chunksInFlight.size() < MAX_READS_IN_FLIGHT) {
+       glm::ivec2 c = pendingChunks.back();
+       pendingChunks.pop_back();
+       chunksInFlight.insert(chunkKey(c.x, c.y));
+       requestChunkRead(c.x, c.y);
+   }
+}
 
 
-   unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-   glShaderSource(vertexShader, 1, &crosshairVertexShaderSource, NULL);
-   glCompileShader(vertexShader);
-  
-   unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-   glShaderSource(fragmentShader, 1, &crosshairFragmentShaderSource, NULL);
-   glCompileShader(fragmentShader);
-  
-   crosshairShader = glCreateProgram();
-   glAttachShader(crosshairShader, vertexShader);
-   glAttachShader(crosshairShader, fragmentShader);
-   glLinkProgram(crosshairShader);
-  
-   glDeleteShader(vertexShader);
-   glDeleteShader(fragmentShader);
+// Periodically snapshots edited chunks for the I/O thread, and asks it to
+// fsync at a slower checkpoint interval
+void updateAutosave() {
+   static double lastAutosave = glfwGetTime();
+   static double lastCheckpoint = glfwGetTime();
+   double now = glfwGetTime();
+
+
+   if (now - lastAutosave >= AUTOSAVE_INTERVAL) {
+       lastAutosave = now;
+       for (const ChunkMap::Slot& slot : world.slots) {
+           if (slot.chunk) saveChunk(*slot.chunk);
+       }
+   }
+   if (now - lastCheckpoint >= CHECKPOINT_INTERVAL) {
+       lastCheckpoint = now;
+       requestCheckpoint();
+   }
 }
 
 
-void renderCrosshair() {
-   glDisable(GL_DEPTH_TEST);
-  
-   glUseProgram(crosshairShader);
-   glBindVertexArray(crosshairVAO);
-  
-   glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
-   glDrawArrays(GL_TRIANGLE_FAN, 4, 4);
-  
-   glBindVertexArray(0);
-   glEnable(GL_DEPTH_TEST);
+// Hands every dirty chunk without a job in flight to the workers, chunks
+// around the camera first, then uploads finished meshes until the frame's
+// upload budget is spent. A chunk edited while its job runs is resubmitted
+// once that job's result is in, so a burst of edits costs one extra remesh.
+void updateChunkMeshes() {
+   static uint64_t lastJob = 0;
+   int submitted = 0;
+   int cameraCX = (int)floor(cameraPos.x) >> CHUNK_SHIFT;
+   int cameraCZ = (int)floor(cameraPos.z) >> CHUNK_SHIFT;
+
+
+   for (const ChunkMap::Slot& slot : world.slots) {
+       Chunk* chunk = slot.chunk;
+       if (!chunk || !chunk->mesh.dirty || chunk->mesh.pendingJob) continue;
+       chunk->mesh.dirty = false;
+       chunk->mesh.pendingJob = ++lastJob;
+       meshJobsInFlight++;
+       submitted++;
+
+
+       bool nearCamera = abs(chunk->cx - cameraCX) <= 1 && abs(chunk->cz - cameraCZ) <= 1;
+       MeshSnapshot snapshot = captureMeshSnapshot(*chunk);
+       int cx = chunk->cx, cz = chunk->cz;
+       uint64_t job = lastJob;
+       submitJob([snapshot, cx, cz, job] {
+           static thread_local MeshInput input;
+           MeshResult* result = new MeshResult();
+           result->cx = cx;
+           result->cz = cz;
+           result->job = job;
+           fillMeshInput(snapshot, input);
+           meshChunk(input, result->vertices, result->counts);
+           pushFinishedMesh(result);
+       }, nearCamera ? JOB_HIGH : JOB_LOW);
+   }
+   remeshesLastFrame = submitted;
+   remeshTotal += submitted;
+
+
+   for (MeshResult* result = takeFinishedMeshes(); result; result = result->next) {
+       meshUploads.push_back(result);
+       meshJobsInFlight--;
+   }
+
+
+   // Always upload at least one mesh so a huge one can't stall forever
+   size_t uploadedBytes = 0, uploaded = 0;
+   for (; uploaded < meshUploads.size() && (uploaded == 0 || uploadedBytes < MESH_UPLOAD_BUDGET_BYTES); uploaded++) {
+       MeshResult* result = meshUploads[uploaded];
+       Chunk* chunk = world.find(result->cx, result->cz);
+       // The chunk may have been unloaded, or unloaded and loaded again
+       if (chunk && chunk->mesh.pendingJob == result->job) {
+           chunk->mesh.pendingJob = 0;
+           uploadChunkMesh(chunk->mesh, *result);
+           uploadedBytes += result->vertices.size() * sizeof(ChunkVertex);
+       }
+       delete result;
+   }
+   meshUploads.erase(meshUploads.begin(), meshUploads.begin() + uploaded);
+   meshUploadsWaiting = meshUploads.size();
+}
+
+
+// Frees finished meshes that were never uploaded; call once the workers are stopped
+void discardFinishedMeshes() {
+   for (MeshResult* result = takeFinishedMeshes(); result;) {
+       MeshResult* next = result->next;
+       delete result;
+       result = next;
+   }
+   for (MeshResult* result : meshUploads) delete result;
+   meshUploads.clear();
+   meshJobsInFlight = 0;
+   meshUploadsWaiting = 0;
+}
+
+
+// Sets every stride-th block to a random type; a stride of 1 gives the noisy worst case
+void randomizeChunk(Chunk& chunk, int stride) {
+   std::shared_ptr<ChunkData> data = chunk.copyData();
+   unsigned int seed = 12345;
+   for (int i = 0; i < CHUNK_VOLUME; i += stride) {
+       seed = seed * 1103515245 + 12345;
+       int x = i % CHUNK_SIZE, z = i / CHUNK_SIZE % CHUNK_SIZE, y = i / (CHUNK_SIZE * CHUNK_SIZE);
+       data->set(x, y, z, (BlockType)((seed >> 16) % BLOCK_TYPE_COUNT));
+   }
+   chunk.publish(data);
+}
+
+
+// Times every mesher on the default world and on a noisy worst case, then
+// exits. Runs without a window since meshing never touches GL.
+void runMesherBenchmark() {
+   const int iterations = 500;
+   const MesherMode modes[] = { MESHER_CULLED, MESHER_GREEDY, MESHER_BINARY, MESHER_INSTANCED };
+
+
+   Chunk chunk;
+   for (int world = 0; world < 2; world++) {
+       if (world == 0) {
+           generateChunk(chunk);
+       } else {
+           randomizeChunk(chunk, 1);
+       }
+       std::cout << (world == 0 ? "Flat world" : "Random world") << ": "
+                 << chunk.data->averageSectionBytes() << " B/section paletted, "
+                 << SECTION_VOLUME * sizeof(BlockType) << " B/section unpacked\n";
+
+
+       for (MesherMode mode : modes) {
+           ChunkMesh mesh;
+           std::vector<ChunkVertex> vertices;
+           static MeshInput input;
+           mesherMode = mode;
+           auto begin = std::chrono::steady_clock::now();
+           for (int i = 0; i < iterations; i++) {
+               fillMeshInput(captureMeshSnapshot(chunk), input);
+               meshChunk(input, vertices, mesh);
+           }
+           std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - begin;
+
+
+           std::cout << "  " << std::left << std::setw(8) << getMesherName(mode) << std::right
+                     << std::fixed << std::setprecision(1) << std::setw(9) << elapsed.count() / iterations << " us/chunk"
+                     << std::setw(8) << vertices.size() << " verts"
+                     << std::setw(9) << vertices.size() * sizeof(ChunkVertex) << " B"
+                     << std::setw(7) << mesh.emittedFaces << " faces\n";
+       }
+   }
+}
+
+
+// Times the chunk codec on generated chunks and reports its compression
+// against the unpacked block array, then exits
+void runCodecBenchmark() {
+   const int iterations = 2000;
+   const char* worldNames[] = { "Flat world", "Edited world", "Random world" };
+
+
+   for (int world = 0; world < 3; world++) {
+       Chunk chunk;
+       generateChunk(chunk);
+       if (world == 1) randomizeChunk(chunk, 97);
+       if (world == 2) randomizeChunk(chunk, 1);
+
+
+       std::vector<uint8_t> sections, payload;
+       for (const ChunkSection& section : chunk.data->sections) encodeSection(section, sections);
+
+
+       auto begin = std::chrono::steady_clock::now();
+       for (int i = 0; i < iterations; i++) encodeChunk(*chunk.data, payload);
+       std::chrono::duration<double> encodeTime = std::chrono::steady_clock::now() - begin;
+
+
+       ChunkData decoded;
+       bool ok = true;
+       begin = std::chrono::steady_clock::now();
+       for (int i = 0; i < iterations; i++) ok &= decodeChunk(payload.data(), payload.size(), decoded);
+       std::chrono::duration<double> decodeTime = std::chrono::steady_clock::now() - begin;
+       for (int i = 0; i < CHUNK_VOLUME && ok; i++) {
+           int x = i % CHUNK_SIZE, z = i / CHUNK_SIZE % CHUNK_SIZE, y = i / (CHUNK_SIZE * CHUNK_SIZE);
+           ok = decoded.get(x, y, z) == chunk.get(x, y, z);
+       }
+
+
+       double megabytes = (double)CHUNK_VOLUME * sizeof(BlockType) * iterations / (1024.0 * 1024.0);
+       std::cout << worldNames[world] << ": " << CHUNK_VOLUME * sizeof(BlockType) << " B unpacked, "
+                 << sections.size() << " B sections, " << payload.size() << " B payload ("
+                 << std::fixed << std::setprecision(1) << (double)CHUNK_VOLUME * sizeof(BlockType) / payload.size() << "x)\n"
+                 << "  encode " << std::setw(8) << megabytes / encodeTime.count() << " MB/s, decode "
+                 << std::setw(8) << megabytes / decodeTime.count() << " MB/s"
+                 << (ok ? "" : "  ROUND TRIP FAILED") << "\n";
+   }
+}
+
+
+// Measures how fast reader threads scan chunk snapshots handed to them by the
+// main thread, alone and while the main thread keeps editing the chunk and
+// publishing new versions, then exits
+void runSnapshotBenchmark() {
+   const double seconds = 1.0;
+   int readers = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+   Chunk chunk;
+   generateChunk(chunk);
+   randomizeChunk(chunk, 97);
+
+
+   // One slot per reader; whoever sees `full` in its state owns `data`
+   struct Mailbox {
+       std::shared_ptr<const ChunkData> data;
+       std::atomic<bool> full{false};
+   };
+
+
+   for (int editing = 0; editing < 2; editing++) {
+       std::atomic<bool> running{true};
+       std::atomic<uint64_t> snapshotsRead{0}, checksum{0};
+       std::vector<Mailbox> mailboxes(readers);
+       std::vector<std::thread> threads;
+       for (int r = 0; r < readers; r++) {
+           threads.emplace_back([&, r] {
+               static thread_local BlockType blocks[CHUNK_VOLUME];
+               Mailbox& mailbox = mailboxes[r];
+               uint64_t count = 0, sum = 0;
+               while (running) {
+                   if (!mailbox.full.load(std::memory_order_acquire)) {
+                       std::this_thread::yield();
+                       continue;
+                   }
+                   std::shared_ptr<const ChunkData> data = std::move(mailbox.data);
+                   mailbox.full.store(false, std::memory_order_release);
+                   data->unpack(blocks);
+                   sum += blocks[count % CHUNK_VOLUME];
+                   count++;
+               }
+               snapshotsRead += count;
+               checksum += sum;
+           });
+       }
+
+
+       uint64_t edits = 0;
+       unsigned int seed = 777;
+       auto begin = std::chrono::steady_clock::now();
+       std::chrono::duration<double> elapsed(0);
+       while (elapsed.count() < seconds) {
+           bool handedOut = false;
+           for (Mailbox& mailbox : mailboxes) {
+               if (mailbox.full.load(std::memory_order_acquire)) continue;
+               mailbox.data = chunk.snapshot();
+               mailbox.full.store(true, std::memory_order_release);
+               handedOut = true;
+           }
+           if (handedOut || !editing) std::this_thread::yield();
+           if (editing) {
+               seed = seed * 1103515245 + 12345;
+               int x = (seed >> 8) & (CHUNK_SIZE - 1), z = (seed >> 12) & (CHUNK_SIZE - 1);
+               int y = 1 + (seed >> 16) % (WORLD_HEIGHT - 1);
+               chunk.set(x, y, z, (BlockType)((seed >> 24) % BLOCK_TYPE_COUNT));
+               edits++;
+           }
+           elapsed = std::chrono::steady_clock::now() - begin;
+       }
+       running = false;
+       for (std::thread& thread : threads) thread.join();
+
+
+       double snapshots = snapshotsRead / elapsed.count();
+       std::cout << (editing ? "With edits:   " : "Readers only: ") << readers << " readers, "
+                 << std::fixed << std::setprecision(0) << snapshots << " snapshots/s, "
+                 << snapshots * CHUNK_VOLUME * sizeof(BlockType) / (1024.0 * 1024.0) << " MB/s read, "
+                 << edits / elapsed.count() << " edits/s published\n";
+   }
+}
+
+
+// Meshes and encodes a batch of noisy chunks with 1, 2, 4... workers and
+// reports the speedup and how busy each worker was, then exits
+void runJobBenchmark() {
+   const int chunkCount = 64;
+   int maxWorkers = std::max(4, (int)std::thread::hardware_concurrency());
+   Chunk chunk;
+   generateChunk(chunk);
+   randomizeChunk(chunk, 3);
+
+
+   double baseline = 0;
+   for (int workerCount = 1; workerCount <= maxWorkers; workerCount *= 2) {
+       startJobs(workerCount);
+       auto begin = std::chrono::steady_clock::now();
+       MeshSnapshot snapshot = captureMeshSnapshot(chunk);
+       parallelFor(chunkCount, 1, [&chunk, &snapshot](int first, int last) {
+           static thread_local MeshInput input;
+           std::vector<ChunkVertex> vertices;
+           std::vector<uint8_t> payload;
+           ChunkMesh mesh;
+           for (int i = first; i < last; i++) {
+               fillMeshInput(snapshot, input);
+               meshChunk(input, vertices, mesh);
+               encodeChunk(*chunk.data, payload);
+           }
+       });
+       std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+       if (workerCount == 1) baseline = elapsed.count();
+
+
+       std::cout << std::setw(3) << workerCount << " workers: " << std::fixed << std::setprecision(1)
+                 << std::setw(8) << elapsed.count() << " ms, " << std::setprecision(2) << baseline / elapsed.count()
+                 << "x, busy";
+       for (JobWorker* worker : jobSystem.workers) {
+           std::cout << " " << std::setprecision(0) << worker->busyMicros / (elapsed.count() * 10) << "%";
+       }
+       uint64_t stolen = 0;
+       for (JobWorker* worker : jobSystem.workers) stolen += worker->jobsStolen;
+       std::cout << ", " << stolen << " stolen\n";
+       stopJobs();
+   }
 }
 
 
-int main() {
+int main(int argc, char** argv) {
+   // Leave a core each for the main and I/O threads
+   int workerCount = std::max(1, (int)std::thread::hardware_concurrency() - 2);
+   for (int i = 1; i < argc; i++) {
+       if (strcmp(argv[i], "--mesher") == 0 && i + 1 < argc) {
+           const char* mode = argv[++i];
+           if (strcmp(mode, "greedy") == 0) mesherMode = MESHER_GREEDY;
+           else if (strcmp(mode, "binary") == 0) mesherMode = MESHER_BINARY;
+           else if (strcmp(mode, "instanced") == 0) mesherMode = MESHER_INSTANCED;
+           else if (strcmp(mode, "culled") == 0) mesherMode = MESHER_CULLED;
+           else std::cerr << "Unknown mesher '" << mode << "', using culled" << std::endl;
+       } else if (strcmp(argv[i], "--render-distance") == 0 && i + 1 < argc) {
+           renderDistance = std::max(1, atoi(argv[++i]));
+       } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+           workerCount = std::max(1, atoi(argv[++i]));
+       } else if (strcmp(argv[i], "--world") == 0 && i + 1 < argc) {
+           worldDirectory = argv[++i];
+       } else if (strcmp(argv[i], "--bench-mesher") == 0) {
+           runMesherBenchmark();
+           return 0;
+       } else if (strcmp(argv[i], "--bench-codec") == 0) {
+           runCodecBenchmark();
+           return 0;
+       } else if (strcmp(argv[i], "--bench-snapshots") == 0) {
+           runSnapshotBenchmark();
+           return 0;
+       } else if (strcmp(argv[i], "--bench-jobs") == 0) {
+           runJobBenchmark();
+           return 0;
+       }
+   }
+
+
    if (!glfwInit()) {
        std::cerr << "Failed to initialize GLFW" << std::endl;
        return -1;
@@ -609,39 +3834,60 @@ int main() {
    }
 
 
-   // Initialize world with 8x8 platform and small hill
-   for (int x = 0; x < CHUNK_SIZE; x++) {
-       for (int z = 0; z < CHUNK_SIZE; z++) {
-           blocks[x][0][z] = DIRT;
-       }
-   }
+   startChunkIO();
+   startJobs(workerCount);
 
 
-   glEnable(GL_DEPTH_TEST);
+   setDepthTest(true);
+   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+   glActiveTexture(GL_TEXTURE0);
    textureID = loadTexture("assets/atlas.png");
    initCrosshair();
 
 
-   // Main shader program
-   const char* vertexShaderSource = "#version 330 core\n"
-       "layout (location = 0) in vec3 aPos;\n"
-       "layout (location = 1) in vec2 aTexCoord;\n"
+   // Main shader program. Texture coordinates run along the face's two axes
+   // (mirrored where needed to keep each tile upright) and are wrapped into
+   // the tile's atlas rectangle in the fragment shader.
+   std::string tileRectCount = std::to_string(BLOCK_TYPE_COUNT * 6);
+   std::string vertexShaderCode = "#version 330 core\n"
+       "layout (location = 0) in uint aVertex;\n"
+       "layout (location = 1) in uint aInstance;\n"
        "out vec2 TexCoord;\n"
+       "flat out vec4 TileRect;\n"
        "uniform mat4 model;\n"
        "uniform mat4 view;\n"
        "uniform mat4 projection;\n"
+       "uniform vec4 tileRects[" + tileRectCount + "];\n"
+       "uniform bool pagedOrigins;\n"
+       "uniform samplerBuffer chunkOrigins;\n"
        "void main() {\n"
-       "   gl_Position = projection * view * model * vec4(aPos, 1.0);\n"
-       "   TexCoord = aTexCoord;\n"
-       "}\0";
+       "   uint vertex = aVertex + aInstance;\n"
+       "   vec3 pos = vec3(vertex & 31u, (vertex >> 5) & 127u, (vertex >> 12) & 31u);\n"
+       "   uint face = (vertex >> 17) & 7u;\n"
+       "   uint type = vertex >> 20;\n"
+       "   vec3 origin = vec3(0.0);\n"
+       "   if (pagedOrigins) {\n"
+       "       vec2 o = texelFetch(chunkOrigins, gl_VertexID >> " + std::to_string(ARENA_PAGE_SHIFT) + ").xy;\n"
+       "       origin = vec3(o.x, 0.0, o.y);\n"
+       "   }\n"
+       "   gl_Position = projection * view * model * vec4(pos + origin, 1.0);\n"
+       "   if (face <= 1u) TexCoord = pos.xy;\n"
+       "   else if (face == 2u) TexCoord = vec2(-pos.z, pos.y);\n"
+       "   else if (face == 3u) TexCoord = pos.zy;\n"
+       "   else TexCoord = vec2(pos.x, -pos.z);\n"
+       "   TileRect = tileRects[type * 6u + face];\n"
+       "}\n";
+   const char* vertexShaderSource = vertexShaderCode.c_str();
 
 
    const char* fragmentShaderSource = "#version 330 core\n"
        "in vec2 TexCoord;\n"
+       "flat in vec4 TileRect;\n"
        "out vec4 FragColor;\n"
        "uniform sampler2D ourTexture;\n"
        "void main() {\n"
-       "   vec4 texColor = texture(ourTexture, TexCoord);\n"
+       "   vec2 atlasCoord = mix(TileRect.xy, TileRect.zw, fract(TexCoord));\n"
+       "   vec4 texColor = texture(ourTexture, atlasCoord);\n"
        "   if(texColor.a < 0.1) discard;\n"
        "   FragColor = texColor;\n"
        "}\0";
@@ -667,7 +3913,36 @@ int main() {
    glDeleteShader(fragmentShader);
 
 
+   // Atlas rectangle of every block type and face, indexed type * 6 + face
+   std::vector<glm::vec4> tileRects;
+   for (int type = 0; type < BLOCK_TYPE_COUNT; type++) {
+       for (int face = 0; face < 6; face++) {
+           FaceUVs uv = getFaceUVs((BlockType)type, faceNames[face]);
+           tileRects.push_back(glm::vec4(uv.u0, uv.v0, uv.u1, uv.v1));
+       }
+   }
+   ChunkShader chunkShader;
+   chunkShader.resolve(shaderProgram);
+   useProgram(chunkShader.program);
+   glUniform4fv(chunkShader.tileRects, tileRects.size(), &tileRects[0][0]);
+   glUniform1i(chunkShader.texture, 0);
+   glUniform1i(chunkShader.chunkOrigins, 1);
+   // Chunk meshes leave the instance attribute disabled, so it reads as zero
+   glVertexAttribI4ui(1, 0, 0, 0, 0);
+   if (mesherMode == MESHER_INSTANCED) {
+       initCube();
+   } else {
+       // Arena vertices carry their chunk origin, so the model matrix stays identity
+       glm::mat4 identity(1.0f);
+       glUniformMatrix4fv(chunkShader.model, 1, GL_FALSE, &identity[0][0]);
+       glUniform1i(chunkShader.pagedOrigins, 1);
+       multiDrawIndirect = GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect;
+   }
+   endGLFrame();
+
+
    while (!glfwWindowShouldClose(window)) {
+       auto frameStart = std::chrono::steady_clock::now();
        float currentFrame = glfwGetTime();
        deltaTime = currentFrame - lastFrame;
        lastFrame = currentFrame;
@@ -677,46 +3952,45 @@ int main() {
        printStats();
 
 
-       glClearColor(skyColor.r, skyColor.g, skyColor.b, 1.0f);
-       glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+       callGL(glClearColor, skyColor.r, skyColor.g, skyColor.b, 1.0f);
+       callGL(glClear, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 
-       glUseProgram(shaderProgram);
-       glUniform1i(glGetUniformLocation(shaderProgram, "ourTexture"), 0);
+       useProgram(chunkShader.program);
 
 
        glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-       glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)WIDTH / (float)HEIGHT, 0.1f, 100.0f);
+       float farPlane = std::max(100.0f, (renderDistance + 1.0f) * CHUNK_SIZE);
+       glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)WIDTH / (float)HEIGHT, 0.1f, farPlane);
 
 
-       glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "view"), 1, GL_FALSE, &view[0][0]);
-       glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, &projection[0][0]);
+       callGL(glUniformMatrix4fv, chunkShader.view, 1, GL_FALSE, &view[0][0]);
+       callGL(glUniformMatrix4fv, chunkShader.projection, 1, GL_FALSE, &projection[0][0]);
+       bindTexture(textureID);
 
 
-       // Draw all opaque blocks first
-       for (int x = 0; x < CHUNK_SIZE; x++) {
-           for (int y = 0; y < WORLD_HEIGHT; y++) {
-               for (int z = 0; z < CHUNK_SIZE; z++) {
-                   if (blocks[x][y][z] != AIR && blocks[x][y][z] != GLASS) {
-                       glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, z));
-                       glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, &model[0][0]);
-                       drawCube(0, 0, 0, blocks[x][y][z]);
-                   }
-               }
-           }
-       }
+       updateStreaming(frameStart);
+       updateChunkMeshes();
+       updateAutosave();
 
 
-       // Then draw transparent blocks (glass)
-       for (int x = 0; x < CHUNK_SIZE; x++) {
-           for (int y = 0; y < WORLD_HEIGHT; y++) {
-               for (int z = 0; z < CHUNK_SIZE; z++) {
-                   if (blocks[x][y][z] == GLASS) {
-                       glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, z));
-                       glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, &model[0][0]);
-                       drawCube(0, 0, 0, blocks[x][y][z]);
-                   }
-               }
+       cullChunks(projection * view);
+
+
+       // Draw all opaque blocks first, then transparent blocks (glass)
+       for (int pass = 0; pass < 2; pass++) {
+           setBlend(pass == 1);
+           setWireframe(wireframeMode);
+           if (mesherMode != MESHER_INSTANCED) {
+               drawArenaMeshes(visibleChunks, pass == 1);
+               continue;
+           }
+           for (const Chunk* chunk : visibleChunks) {
+               const ChunkMesh& mesh = chunk->mesh;
+               if ((pass == 0 ? mesh.opaqueVertexCount : mesh.transparentVertexCount) == 0) continue;
+               glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(chunk->cx * CHUNK_SIZE, 0, chunk->cz * CHUNK_SIZE));
+               callGL(glUniformMatrix4fv, chunkShader.model, 1, GL_FALSE, &model[0][0]);
+               drawChunkMesh(mesh, pass == 1);
            }
        }
 
@@ -725,7 +3999,21 @@ int main() {
       
        glfwSwapBuffers(window);
        glfwPollEvents();
+       endGLFrame();
+   }
+
+
+   for (const ChunkMap::Slot& slot : world.slots) {
+       if (!slot.chunk) continue;
+       saveChunk(*slot.chunk);
+       destroyChunkMesh(slot.chunk->mesh);
    }
+   glDeleteBuffers(1, &quadIndexBuffer);
+   glDeleteBuffers(1, &cubeVBO);
+   destroyVertexArena();
+   stopJobs();
+   discardFinishedMeshes();
+   stopChunkIO();
 
 
    std::cout << "\n";